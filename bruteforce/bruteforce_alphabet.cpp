@@ -1,19 +1,25 @@
 #include <cstdio>
 #include <print>
+#include <string>
 #include <vector>
 
 #include <cipher/alphabet.hpp>
 #include <cipher/base64.hpp>
 #include <cipher/cipher.hpp>
+#include <cipher/constraint.hpp>
+#include <cipher/stats.hpp>
 #include <cipher/vigenere.hpp>
 #include <cipher/bruteforce.hpp>
 
 using namespace cipher::bruteforce;
 
+template<auto ciphertext>
+using alphabet_state = base64_alphabet_bruteforce_state<ciphertext.size()>;
+
 template<auto plaintext_alphabet, auto ciphertext, auto key, auto heuristic, auto you_win, auto progress_report>
-constexpr static void bruteforce_alphabet_vigenere(base64_alphabet_bruteforce_state& state)
+static void bruteforce_alphabet_vigenere(alphabet_state<ciphertext>& state, const parallel_options& options)
 {
-    constexpr static auto get_next_char = []<auto next>(base64_alphabet_bruteforce_state& state) {
+    constexpr static auto get_next_char = []<auto next>(alphabet_state<ciphertext>& state) {
         const auto source_char = ciphertext[state.ciphertext_index];
         const auto key_char = key[(state.ciphertext_index) % key.size()];
         state.alloc_at_all_index(key_char, [&](const char key_char) {
@@ -32,11 +38,16 @@ constexpr static void bruteforce_alphabet_vigenere(base64_alphabet_bruteforce_st
         });
     };
 
-    bruteforce_base64<base64_alphabet_bruteforce_state, ciphertext, get_next_char, heuristic, you_win, progress_report>(state);
+    if (options.uses_frontier())
+        parallel_bruteforce_base64<alphabet_state<ciphertext>, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, options);
+    else {
+        start_progress(state);
+        search_base64<alphabet_state<ciphertext>, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, options);
+    }
 }
 
 template<auto ciphertext>
-constexpr static auto translate_plaintext_substitution(base64_alphabet_bruteforce_state& alphabet, const std::size_t ciphertext_index, const char char_to_translate)
+constexpr static auto translate_plaintext_substitution(alphabet_state<ciphertext>& alphabet, const std::size_t ciphertext_index, const char char_to_translate)
 {
     const auto source_char = ciphertext[ciphertext_index];
     const auto index = cipher::index_in_alphabet<cipher::base64::DEFAULT_ALPHABET>(source_char);
@@ -44,9 +55,9 @@ constexpr static auto translate_plaintext_substitution(base64_alphabet_bruteforc
 }
 
 template<auto ciphertext, auto heuristic, auto you_win, auto progress_report>
-constexpr static void bruteforce_alphabet_substitution(base64_alphabet_bruteforce_state& state)
+static void bruteforce_alphabet_substitution(alphabet_state<ciphertext>& state, const parallel_options& options)
 {
-    constexpr static auto get_next_char = []<auto next>(base64_alphabet_bruteforce_state& state) {
+    constexpr static auto get_next_char = []<auto next>(alphabet_state<ciphertext>& state) {
         const auto cipher_char = ciphertext[state.ciphertext_index];
         const auto cipher_index = cipher::index_in_alphabet<cipher::base64::DEFAULT_ALPHABET>(cipher_char);
         state.template alloc_all_char_at_index<cipher::base64::DEFAULT_ALPHABET>(
@@ -56,7 +67,12 @@ constexpr static void bruteforce_alphabet_substitution(base64_alphabet_bruteforc
             });
     };
 
-    bruteforce_base64<base64_alphabet_bruteforce_state, ciphertext, get_next_char, heuristic, you_win, progress_report>(state);
+    if (options.uses_frontier())
+        parallel_bruteforce_base64<alphabet_state<ciphertext>, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, options);
+    else {
+        start_progress(state);
+        search_base64<alphabet_state<ciphertext>, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, options);
+    }
 }
 
 constexpr static const auto ciphertext = cipher::buffer(
@@ -113,16 +129,18 @@ constexpr static const auto ciphertext = cipher::buffer(
 // [[maybe_unused]] constexpr const auto key = cipher::buffer("TheGiant");
 
 thread_local std::uint64_t iteration{0};
-std::vector<base64_alphabet_bruteforce_state> alphabets;
-static void bruteforce_alphabet(const std::string_view plaintext)
+std::vector<alphabet_state<ciphertext>> alphabets;
+static void bruteforce_alphabet(const std::string_view plaintext, const parallel_options& options)
 {
     constexpr static auto you_win = [](const auto& state) {
         alphabets.push_back(state);
         std::println("FOUND ALPHABET: {:64} PLAINTEXT: {}", state.alphabet_string_view(), state.plaintext_string_view());
     };
     constexpr static auto progress_report = [](const auto& state){
-        if (iteration++ % 100000000 == 0) 
+        if (iteration++ % 100000000 == 0) {
             std::println(stderr, "ALPHABET: {} PLAIN: \n{:64} ", state.alphabet_string_view(), state.plaintext_string_view());
+            print_progress<std::remove_cvref_t<decltype(state)>>(stderr);
+        }
     };
 
     // constexpr static auto common_alphabet = cipher::alphabet::create("abcdefghijklmnopqrstuvwxyz");
@@ -137,21 +155,89 @@ static void bruteforce_alphabet(const std::string_view plaintext)
 
     // auto alphabet = Base64Alphabet::create_starting_configuration("");
     // auto alphabet = Base64Alphabet::create_alphabet_with_plaintext<translate_plaintext_vigenere<plaintext_alphabet, ciphertext>>("Der Riese");
-    auto state = cipher::bruteforce::create_state_with_plaintext<base64_alphabet_bruteforce_state, translate_plaintext_substitution<ciphertext>>(plaintext);
+    if (plaintext.size() > ciphertext.size() / 4 * 3) {
+        std::println(stderr, "known plaintext can be at most {} characters, got {}", ciphertext.size() / 4 * 3, plaintext.size());
+        std::exit(1);
+    }
+    auto state = cipher::bruteforce::create_state_with_plaintext<alphabet_state<ciphertext>, translate_plaintext_substitution<ciphertext>>(plaintext);
 
-    // bruteforce_alphabet_vigenere<plaintext_alphabet, ciphertext, key, heuristic, you_win, progress_report>(alphabet, plaintext);
-    bruteforce_alphabet_substitution<ciphertext, heuristic, you_win, progress_report>(state);
+    // bruteforce_alphabet_vigenere<plaintext_alphabet, ciphertext, key, heuristic, you_win, progress_report>(alphabet, options);
+    bruteforce_alphabet_substitution<ciphertext, heuristic, you_win, progress_report>(state, options);
 
     for(const auto& alphabet : alphabets) {
         std::println(stderr, "FOUND PLAIN: {:64} ALPHABET: {}", alphabet.plaintext_string_view(), alphabet.alphabet_string_view());
     }
 
+    cipher::stats::report();
     std::println("done?");
 }
 
-int main(int, const char* argv[])
+// The substitution search of bruteforce_alphabet solved as a constraint problem,
+// see cipher/constraint.hpp. plaintext is known from the start of the plaintext,
+// extra_cribs anywhere in it.
+static void recover_alphabet(const std::string_view plaintext, const std::vector<cipher::constraint::crib>& extra_cribs)
 {
-    bruteforce_alphabet(std::string_view{ argv[1] });
+    constexpr static auto heuristic = [](const char plain) {
+        return cipher::is_print(plain);
+    };
+
+    static cipher::constraint::problem problem;
+    static std::uint64_t found{ 0 };
+    constexpr static auto you_win = [](const cipher::constraint::domains_t& domains) {
+        found++;
+        std::println("FOUND ALPHABET: {:64} PLAINTEXT: {}", cipher::constraint::alphabet_of(problem, domains), cipher::constraint::plaintext_of(problem, domains));
+    };
+    constexpr static auto progress_report = [](const cipher::constraint::domains_t& domains){
+        if (iteration++ % 1000000 == 0)
+            std::println(stderr, "ALPHABET: {} NODES: {}", cipher::constraint::alphabet_of(problem, domains), iteration);
+    };
+
+    auto cribs = extra_cribs;
+    cribs.push_back({ 0, plaintext });
+    problem = cipher::constraint::create_problem<ciphertext, heuristic>(cribs);
+    cipher::constraint::solve<you_win, progress_report>(problem);
+
+    std::println(stderr, "FOUND {} ALPHABETS IN {} NODES", found, iteration);
+    std::println("done?");
+}
+
+int main(int argc, const char* argv[])
+{
+    if (argc > 1 && std::string_view{ argv[1] } == "--constraints") {
+        std::vector<cipher::constraint::crib> cribs;
+        for(auto i = 3; i < argc; i++) {
+            const std::string_view crib{ argv[i] };
+            const auto colon = crib.find(':');
+            if (colon == std::string_view::npos) {
+                std::println(stderr, "crib must be offset:plaintext, got {}", crib);
+                std::exit(1);
+            }
+            cribs.push_back({ std::stoul(std::string{ crib.substr(0, colon) }), crib.substr(colon + 1) });
+        }
+        recover_alphabet(argc > 2 ? argv[2] : "", cribs);
+        return 0;
+    }
+
+    parallel_options options;
+    if (argc > 2)
+        options.thread_count = std::stoul(argv[2]);
+    if (argc > 3)
+        options.split_depth = std::stoul(argv[3]);
+    if (argc > 4)
+        options.checkpoint_path = argv[4];
+    // argv[5] set to "iterative" runs the search on an explicit stack, for
+    // ciphertexts too long to recurse through.
+    if (argc > 5 && std::string_view{ argv[5] } == "iterative")
+        options.iterative = true;
+    // The known plaintext is the only other input that shapes the search.
+    options.search_parameters = argv[1];
+
+    try {
+        bruteforce_alphabet(std::string_view{ argv[1] }, options);
+    } catch(const cipher::checkpoint::invalid_checkpoint& e) {
+        std::println(stderr, "{}; remove it to start the search over", e.what());
+        std::exit(1);
+    }
     return 0;
 }
 
@@ -1,6 +1,7 @@
 #include <cstdio>
 #include <cstring>
 #include <print>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -8,6 +9,7 @@
 #include <cipher/base64.hpp>
 #include <cipher/bruteforce.hpp>
 #include <cipher/cipher.hpp>
+#include <cipher/stats.hpp>
 #include <cipher/vigenere.hpp>
 
 using namespace cipher::bruteforce;
@@ -48,27 +50,32 @@ constexpr static auto translate_plaintext_double_vigenere(base64_key_bruteforce_
     state.alloc(alphabet[key_char_index]);
 }
 
+template<auto ciphertext, auto key>
+constexpr static char decode_double_vigenere(const std::string_view searched_key, const std::size_t ciphertext_index)
+{
+    char key_chars[2]{ 0 };
+    if constexpr (the_giant_first_decode) {
+        key_chars[0] = key[ciphertext_index % key.size()];
+        key_chars[1] = searched_key[ciphertext_index % searched_key.size()];
+    } else {
+        key_chars[0] = searched_key[ciphertext_index % searched_key.size()];
+        key_chars[1] = key[ciphertext_index % key.size()];
+    }
+    char source_char = ciphertext[ciphertext_index];
+    for(auto i = 0u; i < 2; i++) {
+        const auto key_char_as_index = static_cast<std::uint8_t>(key_chars[i]);
+        const auto source_char_as_index = static_cast<std::uint8_t>(source_char);
+        source_char = decode_table[ati[source_char_as_index]][ati[key_char_as_index]];
+    }
+    return source_char;
+}
+
 template<std::size_t max_key_size, auto key_alphabet, auto ciphertext, auto key, auto heuristic, auto you_win, auto progress_report>
-constexpr static void bruteforce_key_vigenere(base64_key_bruteforce_state& state)
+static void bruteforce_key_vigenere(base64_key_bruteforce_state& state, const parallel_options& options, const shard_options& shards)
 {
     constexpr static auto get_next_char = []<auto next>(base64_key_bruteforce_state& state) {
         constexpr static auto decode = [](auto& state){
-            char key_chars[2]{ 0 };
-            if constexpr (the_giant_first_decode) {
-                key_chars[0] = key[state.ciphertext_index % key.size()];
-                key_chars[1] = state.key[state.ciphertext_index % state.key_index];
-            } else {
-                key_chars[0] = state.key[state.ciphertext_index % state.key_index];
-                key_chars[1] = key[state.ciphertext_index % key.size()];
-            }
-            char source_char = ciphertext[state.ciphertext_index];
-            for(auto i = 0u; i < 2; i++) {
-                const auto key_char_as_index = static_cast<std::uint8_t>(key_chars[i]);
-                const auto source_char_as_index = static_cast<std::uint8_t>(source_char);
-                source_char = decode_table[ati[source_char_as_index]][ati[key_char_as_index]];
-            }
-
-            next(state, source_char);
+            next(state, decode_double_vigenere<ciphertext, key>(state.key_string_view(), state.ciphertext_index));
         };
         if (state.key_index < max_key_size && !state.trying_repeat) {
             state.template new_char<key_alphabet, decode>();
@@ -81,7 +88,16 @@ constexpr static void bruteforce_key_vigenere(base64_key_bruteforce_state& state
         }
     };
 
-    bruteforce_base64<base64_key_bruteforce_state, ciphertext, get_next_char, heuristic, you_win, progress_report>(state);
+    if (shards.worker)
+        shard_worker_bruteforce_base64<base64_key_bruteforce_state, ciphertext, get_next_char, heuristic, progress_report>(options, shards);
+    else if (!shards.socket_path.empty())
+        sharded_bruteforce_base64<base64_key_bruteforce_state, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, options, shards);
+    else if (options.uses_frontier())
+        parallel_bruteforce_base64<base64_key_bruteforce_state, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, options);
+    else {
+        start_progress(state);
+        search_base64<base64_key_bruteforce_state, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, options);
+    }
 }
 
 constexpr static const auto ciphertext = cipher::buffer(
@@ -92,18 +108,26 @@ constexpr static const auto ciphertext = cipher::buffer(
 constexpr const auto key = cipher::buffer("TheGiant");
 
 thread_local std::uint64_t iteration{0};
-std::vector<base64_key_bruteforce_state> keys;
-static void bruteforce_key(const std::string_view plaintext)
+std::vector<key_hit> keys;
+
+static std::string plaintext_of(const std::string_view searched_key, const std::size_t plaintext_length)
+{
+    return key_plaintext<decode_double_vigenere<ciphertext, key>>(searched_key, plaintext_length);
+}
+
+static void bruteforce_key(const std::string_view plaintext, const parallel_options& options, const shard_options& shards)
 {
     constexpr static const auto max_key_size = 17;
 
-    constexpr static auto you_win = [](const auto& state) {
-        keys.push_back(state);
-        std::println("FOUND KEY: {:64} PLAINTEXT:\n{}", state.key_string_view(), state.plaintext_string_view());
+    constexpr static auto you_win = [](const base64_key_bruteforce_state& state) {
+        keys.push_back(key_hit::of(state, 0));
+        std::println("FOUND KEY: {:64} PLAINTEXT:\n{}", state.key_string_view(), plaintext_of(state.key_string_view(), state.plaintext_index));
     };
-    constexpr static auto progress_report = [](const auto& state){
-        if (iteration++ % 100000000 == 0) 
-            std::println(stderr, "KEY: {:24} PLAIN:\n{:64}", state.key_string_view(), state.plaintext_string_view());
+    constexpr static auto progress_report = [](const base64_key_bruteforce_state& state){
+        if (iteration++ % 100000000 == 0) {
+            std::println(stderr, "KEY: {:24} PLAIN:\n{:64}", state.key_string_view(), plaintext_of(state.key_string_view(), state.plaintext_index));
+            print_progress<base64_key_bruteforce_state>(stderr);
+        }
     };
 
     // constexpr static auto common_alphabet = cipher::alphabet::create("abcdefghijklmnopqrstuvwxyz");
@@ -123,6 +147,12 @@ static void bruteforce_key(const std::string_view plaintext)
     // std::memcpy(state.key, plaintext.begin(), plaintext.size());
     // state.key_index = plaintext.size();
 
+    // Every known base64 character pins down one key character.
+    if (plaintext.size() * 4 / 3 > base64_key_bruteforce_state::MAX_KEY_SIZE || plaintext.size() > ciphertext.size() / 4 * 3) {
+        std::println(stderr, "known plaintext can be at most {} characters, got {}",
+                     std::min(base64_key_bruteforce_state::MAX_KEY_SIZE * 3 / 4, ciphertext.size() / 4 * 3), plaintext.size());
+        std::exit(1);
+    }
     auto state = create_state_with_plaintext<base64_key_bruteforce_state, translate_plaintext_double_vigenere<ciphertext, key>>(plaintext);
 
     bruteforce_key_vigenere<max_key_size,
@@ -131,17 +161,43 @@ static void bruteforce_key(const std::string_view plaintext)
                             key,
                             heuristic,
                             you_win,
-                            progress_report>(state);
+                            progress_report>(state, options, shards);
 
     for(const auto& key : keys)
         std::println(stderr, 
-                     "\nFOUND PLAIN:\n{}\nKEY: {}", key.plaintext_string_view(), key.key_string_view());
+                     "\nFOUND PLAIN:\n{}\nKEY: {}", plaintext_of(key.key_string_view(), key.plaintext_length), key.key_string_view());
 
+    cipher::stats::report();
     std::println("done?");
 }
 
-int main(int, const char* argv[])
+int main(int argc, const char* argv[])
 {
-    bruteforce_key(std::string_view{ argv[1] });
+    parallel_options options;
+    if (argc > 2)
+        options.thread_count = std::stoul(argv[2]);
+    if (argc > 3)
+        options.split_depth = std::stoul(argv[3]);
+    if (argc > 4)
+        options.checkpoint_path = argv[4];
+    // The known plaintext is the only other input that shapes the search.
+    options.search_parameters = argv[1];
+
+    // argv[5] is a unix socket to coordinate worker processes on, argv[6] either
+    // the number of local workers to start or "worker" to join as one.
+    shard_options shards;
+    if (argc > 5)
+        shards.socket_path = argv[5];
+    if (argc > 6 && std::string_view{ argv[6] } == "worker")
+        shards.worker = true;
+    else if (argc > 6)
+        shards.local_workers = std::stoul(argv[6]);
+
+    try {
+        bruteforce_key(std::string_view{ argv[1] }, options, shards);
+    } catch(const cipher::checkpoint::invalid_checkpoint& e) {
+        std::println(stderr, "{}; remove it to start the search over", e.what());
+        std::exit(1);
+    }
     return 0;
 }
@@ -1,55 +1,112 @@
+#include <algorithm>
+#include <bit>
+#include <cctype>
 #include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
 #include <print>
+#include <string>
 #include <vector>
 #include <utility>
 
+#include <argparse.hpp>
+
 #include <cipher/alphabet.hpp>
 #include <cipher/base64.hpp>
 #include <cipher/bruteforce.hpp>
 #include <cipher/cipher.hpp>
+#include <cipher/frequency.hpp>
+#include <cipher/ngram.hpp>
+#include <cipher/period.hpp>
+#include <cipher/stats.hpp>
 #include <cipher/vigenere.hpp>
 
 using namespace cipher::bruteforce;
 
-constexpr static auto alphabet = cipher::alphabet::create("DAFCBEGHLINKJMOPTQVSRUWXbYdaZcefjglihkmnrotqpsuvzw1yx023749658+/");
-// constexpr static auto alphabet = cipher::base64::DEFAULT_ALPHABET;
-constexpr static auto ati = cipher::alphabet::create_ascii_to_index_array(alphabet);
-constexpr static auto table = cipher::vigenere::create_table(alphabet);
-constexpr static auto decode_table = cipher::vigenere::create_decode_table(alphabet, ati);
+template<auto vigenere_alphabet>
+struct static_vigenere_tables
+{
+    constexpr static auto alphabet = vigenere_alphabet;
+    constexpr static auto ati = cipher::alphabet::create_ascii_to_index_array(alphabet);
+    constexpr static auto table = cipher::vigenere::create_table(alphabet);
+    constexpr static auto decode_table = cipher::vigenere::create_decode_table(alphabet, ati);
+};
+
+struct runtime_vigenere_tables
+{
+    inline static cipher::alphabet::alphabet_t<64> alphabet{};
+    inline static cipher::alphabet::ascii_to_index_t ati{};
+    inline static cipher::vigenere::vignere_table_t<64, char> table{};
+    inline static cipher::vigenere::vignere_table_t<64, char> decode_table{};
+
+    static void set(const std::string_view vigenere_alphabet)
+    {
+        std::copy(vigenere_alphabet.begin(), vigenere_alphabet.end(), alphabet.begin());
+        ati = cipher::alphabet::create_ascii_to_index_array(alphabet);
+        table = cipher::vigenere::create_table(alphabet);
+        decode_table = cipher::vigenere::create_decode_table(alphabet, ati);
+    }
+};
+
+static cipher::ngram::model<4> language_model;
 
+template<typename tables>
 constexpr static auto find_index(const std::uint8_t row_index, const char looking_for)
 {
-    for(auto i = 0u; i < table.size(); i++)
-        if (table[row_index][i] == looking_for)
+    for(auto i = 0u; i < tables::table.size(); i++)
+        if (tables::table[row_index][i] == looking_for)
             return i;
     std::unreachable();
 };
 
 
-template<auto ciphertext>
+// The key character that turns the base64 character char_to_translate into the
+// ciphertext character at ciphertext_index.
+template<typename tables, auto ciphertext>
+constexpr static char implied_key_char(const std::size_t ciphertext_index, const char char_to_translate)
+{
+    const auto char_to_translate_index = tables::ati[static_cast<std::uint8_t>(char_to_translate)];
+    const auto key_char_index = find_index<tables>(char_to_translate_index, ciphertext[ciphertext_index]);
+    return tables::alphabet[key_char_index];
+}
+
+template<typename tables, auto ciphertext>
 constexpr static auto translate_plaintext_vigenere(base64_key_bruteforce_state& state, const std::size_t ciphertext_index, const char char_to_translate)
 {
-    const auto char_to_translate_index = ati[static_cast<std::uint8_t>(char_to_translate)];
-    const auto key_char_index = find_index(char_to_translate_index, ciphertext[ciphertext_index]);
-    state.alloc(alphabet[key_char_index]);
+    state.alloc(implied_key_char<tables, ciphertext>(ciphertext_index, char_to_translate));
+}
+
+// Fixes the key length to its size and the characters that are not '?'.
+constexpr static auto key_pattern = cipher::runtime_buffer<struct key_pattern_tag>{};
+
+template<typename tables, auto ciphertext>
+constexpr static char decode_vigenere(const std::string_view key, const std::size_t ciphertext_index)
+{
+    const auto key_char_as_index = static_cast<std::uint8_t>(key[ciphertext_index % key.size()]);
+    const auto source_char_as_index = static_cast<std::uint8_t>(ciphertext[ciphertext_index]);
+    return tables::decode_table[tables::ati[source_char_as_index]][tables::ati[key_char_as_index]];
 }
 
-template<std::size_t max_key_size, auto key_alphabet, auto ciphertext, auto heuristic, auto you_win, auto progress_report>
-constexpr static void bruteforce_key_vigenere(base64_key_bruteforce_state& state)
+template<typename tables, auto max_key_size, auto key_alphabet, auto ciphertext, auto heuristic, auto you_win, auto progress_report>
+static void bruteforce_key_vigenere(base64_key_bruteforce_state& state, const parallel_options& options, const shard_options& shards, const beam_options& beam)
 {
     constexpr static auto get_next_char = []<auto next>(base64_key_bruteforce_state& state) {
         constexpr static auto decode = [](auto& state){
-            const auto key_char = state.key[state.ciphertext_index % state.key_index];
-            char source_char = ciphertext[state.ciphertext_index];
-
-            const auto key_char_as_index = static_cast<std::uint8_t>(key_char);
-            const auto source_char_as_index = static_cast<std::uint8_t>(source_char);
-            source_char = decode_table[ati[source_char_as_index]][ati[key_char_as_index]];
-
-            next(state, source_char);
+            next(state, decode_vigenere<tables, ciphertext>(state.key_string_view(), state.ciphertext_index));
         };
-        if (state.key_index < max_key_size && !state.trying_repeat && state.key_index < ciphertext.size()) {
+        if (key_pattern.size() != 0) {
+            if (state.key_index >= key_pattern.size()) {
+                decode(state);
+            } else if (const auto c = key_pattern[state.key_index]; c != '?') {
+                state.alloc(c);
+                decode(state);
+                state.dealloc();
+            } else {
+                state.template new_char<key_alphabet, decode>();
+            }
+        } else if (state.key_index < max_key_size && !state.trying_repeat && state.key_index < ciphertext.size()) {
             state.template new_char<key_alphabet, decode>();
             if (state.key_index != 0) {
                 const auto trying_repeat = state.trying_repeat;
@@ -62,10 +119,53 @@ constexpr static void bruteforce_key_vigenere(base64_key_bruteforce_state& state
         }
     };
 
-    bruteforce_base64<base64_key_bruteforce_state, ciphertext, get_next_char, heuristic, you_win, progress_report>(state);
+    constexpr static auto score = [](const base64_key_bruteforce_state& state) {
+        return language_model.average(key_plaintext<decode_vigenere<tables, ciphertext>>(state.key_string_view(), state.plaintext_index));
+    };
+
+    if (shards.worker)
+        shard_worker_bruteforce_base64<base64_key_bruteforce_state, ciphertext, get_next_char, heuristic, progress_report>(options, shards);
+    else if (!shards.socket_path.empty())
+        sharded_bruteforce_base64<base64_key_bruteforce_state, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, options, shards);
+    else if (beam.width != 0)
+        beam_bruteforce_base64<base64_key_bruteforce_state, ciphertext, get_next_char, heuristic, you_win, progress_report, score>(state, beam);
+    else if (options.uses_frontier())
+        parallel_bruteforce_base64<base64_key_bruteforce_state, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, options);
+    else {
+        start_progress(state);
+        search_base64<base64_key_bruteforce_state, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, options);
+    }
 }
 
-constexpr static const auto ciphertext = cipher::buffer(
+// Batch mode: one key tree for every ciphertext in ciphertexts. The key and the
+// repeat handling are the same as above, the per-target decode happens in
+// base64_multi_decode_char.
+template<typename tables, auto max_key_size, auto key_alphabet, auto ciphertexts, auto heuristic, auto you_win, auto progress_report>
+static void bruteforce_key_vigenere_multi(base64_multi_key_bruteforce_state& state)
+{
+    constexpr static auto get_next_char = []<auto next>(base64_multi_key_bruteforce_state& state) {
+        if (state.key_index < max_key_size && !state.trying_repeat && state.key_index < longest_ciphertext<ciphertexts>()) {
+            state.template new_char<key_alphabet, next>();
+            if (state.key_index != 0) {
+                const auto trying_repeat = state.trying_repeat;
+                state.trying_repeat = true;
+                next(state);
+                state.trying_repeat = trying_repeat;
+            }
+        } else {
+            next(state);
+        }
+    };
+    constexpr static auto decode = [](const base64_multi_key_bruteforce_state& state, const std::size_t target) {
+        const auto key_char = state.key[state.ciphertext_index % state.key_index];
+        const auto source_char = ciphertexts[target][state.ciphertext_index];
+        return tables::decode_table[tables::ati[static_cast<std::uint8_t>(source_char)]][tables::ati[static_cast<std::uint8_t>(key_char)]];
+    };
+
+    bruteforce_base64_multi<base64_multi_key_bruteforce_state, ciphertexts, get_next_char, decode, heuristic, you_win, progress_report>(state);
+}
+
+constexpr static const auto default_ciphertext = cipher::buffer(
     "kCmlgFi6GuJNgkNI1Q41fbfyLoCFTCvlqkZiI0KIAXAzP1U1uy1BE4U"
     "fPBfpKmmLObjYnQNRBaPtKiVWzc5A4v0w3xIe8FOhAGJZ7g4in0wn"
     "dJxMOvO3dc1M82at2T6935roTqyWDgtGD/hwwRF3oHqFM5Vcw1"
@@ -73,58 +173,557 @@ constexpr static const auto ciphertext = cipher::buffer(
 // constexpr static const auto ciphertext = cipher::buffer(
 //     "78NpigQbEfgceud4PiY7e4VBzwvK/NiIkcJUGFYtsR9wHOjIDhToIqKXy3aWHp7wtkm6PJLJ1T3aey3DeYy5GAJU45O+l+5arQsvvLIGEY4CjepIlc2dMD4PVwkE7ohkorAoZrJbwZB4IlNJW1frZ8OWpX0lcvdI3hxtb8XDkfplBkGs0B9gbtJXaFUnD/4jjX58T6Hz0ogb+zhaY3yxakbpW/GQbkZ7i+AS4E44GEV35gUCew45SwMvAO/C7PORVJtHvlVipfgNg4UU+ZQzPjG/W/D9wo3JGmbyYO+D+8J3yeD44nsTkDnXQXFH6lsCch9Br/SWza62/xEaIqI8My2fvY9XC+RJ8n3AUtDQpi/P7SF/q4MiFEu4CxTgN9xPIJq9mQGTJukIakRagOLX3sStqXObTAI11UFyNQJEUhO6AL2zb04XxBIJ08ckMAWqajVXyYZA4VEj4BYo/CXRXq74uV7nhBcNFC4mSOZqV5/zgdoeDDUoyl61jmqk8bDW7rJMuX2FR69a8iNcjWFRf7BQ9Wd0RSTYE2R6OGMXplgEeH9chnA4+fytYBHwQSXaOPzffy/IVUpGtnRXYfc6u2pRegr2GTjspmqFkDbnToquwH2TS+b5BbyThs9twn/UW/GqTOYX490/fcDnRfKcY3uNf4yO/jwIPa9PyV61UURrF9rjejZ29TbRsABRhYLHDdlqBEvJ9wA5kB4xJ7my3OL87aHizxd+/Y0+XO7U57S8E050ToDSJZAKeJwc3k1GPBpUCnwUn9Gv1+mJa+gx+c/sc07yssr47pGifWZrJHi7+QC8OgRJgFHz+Fb09OZE+sFEKcOm2IEtPQWOGOpHjQSGUlV6/qzgy9EIgWAGI1rOoxOrpizaBY5yxrFphkQOOUyTBG8CvYLVvxucVApi6s7f7ce+F+WWs/yh0G8VuZMXkzHJHYU0+nOhjXUy3drEOvvlaoTbTng0QImPdQrKQvoSr0qb9NJZVY5njNbvHLacL65FSlA3pX5WkrXDJVP64FKD413Zh+dGKO11B16mVZsn3zycljbOxzrRBW7aJ/C8hYcM1LoHeHCKLvuUTx7oaoEWiD+NAVzjeLiS3jB2zP33C9bSTPc5WjC0piSNgly/67Fvl1YpCZbbopN5rmXkRo9TKa+2VWUmiqVIO7PnMlK+A05v/etvxOHb069JRA9xGOvuIZXp2hwn7B2daJ2xGD/YS2Hcz+KQG4qQWqbVDVrjW4+46LPSp/CJCy6bHh6+RTAgwgV4GR6Zmd0hgQYeXG1IDYIW6ZXxoKEoLK5zqKNkYPWOqoHeeh2ivZM+TSKGxpnlBko50RQ5nTXWJlYo5LsgUEHrlqoDjinBsfBWmdB92g1W8R5PI2qrTMmk2PzY9Br/bIjbvOSgs6IOrrFOuODjlnJzVlm7ptl");
 
+constexpr static auto giant_alphabet = cipher::alphabet::create("DAFCBEGHLINKJMOPTQVSRUWXbYdaZcefjglihkmnrotqpsuvzw1yx023749658+/");
+constexpr static auto letters_alphabet = cipher::alphabet::create("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz");
+
+constexpr static auto ciphertext = cipher::runtime_buffer<struct ciphertext_tag>{};
+constexpr static auto ciphertexts = cipher::runtime_buffer_list<struct ciphertexts_tag>{};
+constexpr static auto key_alphabet = cipher::runtime_buffer<struct key_alphabet_tag>{};
+constexpr static auto max_key_size = cipher::runtime_value<struct max_key_size_tag, std::size_t>{};
+static std::array<bool, 256> plaintext_alphabet{};
+// Keys tried per key length when fitting columns instead of searching.
+constexpr static auto column_keys = cipher::runtime_value<struct column_keys_tag, std::size_t>{};
+
 thread_local std::uint64_t iteration{0};
-std::vector<base64_key_bruteforce_state> keys;
-static void bruteforce_key(const std::string_view plaintext)
+std::vector<key_hit> keys;
+
+template<typename tables>
+static std::string plaintext_of(const std::string_view key, const std::size_t plaintext_length)
 {
-    constexpr static const auto max_key_size = 11;
+    return key_plaintext<decode_vigenere<tables, ciphertext>>(key, plaintext_length);
+}
 
-    constexpr static auto you_win = [](const auto& state) {
-        keys.push_back(state);
-        std::println("FOUND KEY: {:64} PLAINTEXT:\n{}", state.key_string_view(), state.plaintext_string_view());
-    };
-    constexpr static auto progress_report = [](const auto& state){
-        if (iteration++ % 100000000 == 0) 
-            std::println(stderr, "KEY: {:24} PLAIN:\n{:64}", state.key_string_view(), state.plaintext_string_view());
-    };
+// Hits are scored with the n-gram model, which scores everything 0 unless the
+// ngram heuristic or the beam search loaded it.
+template<typename tables>
+constexpr static auto you_win = [](const base64_key_bruteforce_state& state) {
+    const auto plaintext = plaintext_of<tables>(state.key_string_view(), state.plaintext_index);
+    keys.push_back(key_hit::of(state, language_model.average(plaintext)));
+    std::println("FOUND KEY: {:64} PLAINTEXT:\n{}", state.key_string_view(), plaintext);
+};
+std::vector<base64_multi_key_bruteforce_state> batch_keys;
 
-    // constexpr static auto common_alphabet = cipher::alphabet::create("abcdefghijklmnopqrstuvwxyz");
-    // constexpr static auto common_alphabet = cipher::alphabet::create("ABCDEFGHIJKLMNOPQRTSUVWXYZabcdefghijklmnopqrstuvwxyz1234567890!.,:@()\"'/\n\r\t ");
-    // constexpr static auto common_alphabet = cipher::alphabet::create("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ \r\n0123456789");
-    constexpr static auto common_alphabet = cipher::alphabet::create("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ");
-    // constexpr static auto common_alphabet = cipher::alphabet::create("0123456789 ");
-    constexpr static auto heuristic = [](const auto plain) {
-        return cipher::is_in_alphabet<common_alphabet>(plain);
-        // return cipher::is_print(plain);
-        // return cipher::is_common_print(plain);
-    };
+constexpr static auto batch_you_win = [](const base64_multi_key_bruteforce_state& state) {
+    batch_keys.push_back(state);
+    std::println("FOUND KEY: {:64} TARGETS: {}", state.key_string_view(), std::popcount(state.valid_targets));
+    for(auto target = 0u; target < ciphertexts.size(); target++)
+        if (state.is_valid(target))
+            std::println("  [{}] {}", target, state.plaintext_string_view(target).substr(0, ciphertexts[target].size() * 3 / 4));
+};
+constexpr static auto batch_progress_report = [](const base64_multi_key_bruteforce_state& state){
+    if (iteration++ % 100000000 == 0)
+        std::println(stderr, "KEY: {:24} TARGETS: {}", state.key_string_view(), std::popcount(state.valid_targets));
+};
+template<typename tables>
+constexpr static auto progress_report = [](const base64_key_bruteforce_state& state){
+    if (iteration++ % 100000000 == 0) {
+        std::println(stderr, "KEY: {:24} PLAIN:\n{:64}", state.key_string_view(), plaintext_of<tables>(state.key_string_view(), state.plaintext_index));
+        print_progress<base64_key_bruteforce_state>(stderr);
+    }
+};
 
-    constexpr static auto key_alphabet = cipher::alphabet::create("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz");
-    // constexpr static auto key_alphabet = cipher::base64::DEFAULT_ALPHABET;
+constexpr static auto in_alphabet_heuristic = [](const auto plain) {
+    return plaintext_alphabet[static_cast<std::uint8_t>(plain)];
+};
+constexpr static auto print_heuristic = [](const auto plain) {
+    return cipher::is_print(plain);
+};
+constexpr static auto common_print_heuristic = [](const auto plain) {
+    return cipher::is_common_print(plain);
+};
+constexpr static auto ngram_heuristic = [](const auto& state, const std::size_t index) {
+    return cipher::is_print(state.plaintext[index]) && language_model.plausible(state.plaintext, index);
+};
+
+// Fits every key column on its own against what accept lets through, then checks
+// the column_keys best keys of each length in full. Lengths come from the key
+// pattern or, without one, all of them likeliest first.
+template<typename tables, auto key_alphabet, auto accept>
+static void solve_columns(const std::string_view plaintext)
+{
+    const auto model = cipher::frequency::base64_model::from_alphabet(accept);
+    const auto plaintext_length = ciphertext.size() * 3 / 4;
 
-    // (void)plaintext;
-    // auto state = base64_key_bruteforce_state{};
-    // std::memcpy(state.key, plaintext.begin(), plaintext.size());
-    // state.key_index = plaintext.size();
+    std::vector<std::size_t> periods;
+    if (key_pattern.size() != 0)
+        periods.push_back(key_pattern.size());
+    else
+        for(const auto& estimate : cipher::period::rank(ciphertext.contents, tables::ati, tables::alphabet.size(), max_key_size, 4))
+            periods.push_back(estimate.period);
 
-    auto state = create_state_with_plaintext<base64_key_bruteforce_state, translate_plaintext_vigenere<ciphertext>>(plaintext);
+    for(const auto period : periods) {
+        std::vector<std::vector<cipher::frequency::candidate>> columns;
+        for(auto column = 0u; column < period; column++) {
+            if (key_pattern.size() != 0 && key_pattern[column] != '?')
+                columns.push_back({ { key_pattern[column], 0.f } });
+            else
+                columns.push_back(cipher::frequency::score_column<decode_vigenere<tables, ciphertext>>(model, key_alphabet, ciphertext.size(), period, column));
+        }
 
-    bruteforce_key_vigenere<max_key_size,
-                            key_alphabet,
-                            ciphertext,
-                            heuristic,
-                            you_win,
-                            progress_report>(state);
+        cipher::frequency::best_keys(columns, column_keys, [&](const std::string_view key, const float score) {
+            if (key_pattern.size() == 0 && cipher::frequency::is_repeat(key))
+                return true;
+            const auto text = plaintext_of<tables>(key, plaintext_length);
+            if (!text.starts_with(plaintext) || !std::all_of(text.begin(), text.end(), accept))
+                return true;
+            key_hit hit{ static_cast<std::uint8_t>(key.size()), static_cast<std::uint16_t>(plaintext_length), language_model.average(text) };
+            std::copy(key.begin(), key.end(), hit.key);
+            keys.push_back(hit);
+            std::println("FOUND KEY: {:64} FIT: {:.1f} PLAINTEXT:\n{}", key, score, text);
+            return true;
+        });
+    }
+}
+
+template<typename tables, auto key_alphabet>
+static void bruteforce_key(const std::string_view plaintext,
+                           const std::string_view heuristic,
+                           const parallel_options& options,
+                           const shard_options& shards,
+                           const beam_options& beam)
+{
+    // --periods and --drag-search run one search per key pattern, and each one
+    // reports and checkpoints only its own keys.
+    keys.clear();
+    auto search_options = options;
+    search_options.search_parameters += key_pattern.contents;
+
+    auto state = create_state_with_plaintext<base64_key_bruteforce_state, translate_plaintext_vigenere<tables, ciphertext>>(plaintext);
+    // Known plaintext longer than the pattern must repeat the key.
+    if (key_pattern.size() != 0) {
+        for(auto i = 0u; i < state.key_index; i++) {
+            const auto expected = i < key_pattern.size() ? key_pattern[i] : state.key[i % key_pattern.size()];
+            if (expected != '?' && expected != state.key[i]) {
+                std::println(stderr, "known plaintext contradicts key pattern {}", key_pattern.contents);
+                return;
+            }
+        }
+        while(state.key_index > key_pattern.size())
+            state.dealloc();
+    }
+
+    if (column_keys != 0) {
+        if (heuristic == "alphabet")
+            solve_columns<tables, key_alphabet, in_alphabet_heuristic>(plaintext);
+        else if (heuristic == "print")
+            solve_columns<tables, key_alphabet, print_heuristic>(plaintext);
+        else
+            solve_columns<tables, key_alphabet, common_print_heuristic>(plaintext);
+    } else if (heuristic == "alphabet")
+        bruteforce_key_vigenere<tables, max_key_size, key_alphabet, ciphertext, in_alphabet_heuristic, you_win<tables>, progress_report<tables>>(state, search_options, shards, beam);
+    else if (heuristic == "ngram")
+        bruteforce_key_vigenere<tables, max_key_size, key_alphabet, ciphertext, ngram_heuristic, you_win<tables>, progress_report<tables>>(state, search_options, shards, beam);
+    else if (heuristic == "print")
+        bruteforce_key_vigenere<tables, max_key_size, key_alphabet, ciphertext, print_heuristic, you_win<tables>, progress_report<tables>>(state, search_options, shards, beam);
+    else
+        bruteforce_key_vigenere<tables, max_key_size, key_alphabet, ciphertext, common_print_heuristic, you_win<tables>, progress_report<tables>>(state, search_options, shards, beam);
 
     for(const auto& key : keys)
-        std::println(stderr, 
-                     "\nFOUND PLAIN:\n{}\nKEY: {}", key.plaintext_string_view(), key.key_string_view());
+        std::println(stderr,
+                     "\nFOUND PLAIN:\n{}\nKEY: {} SCORE: {:.3f}", plaintext_of<tables>(key.key_string_view(), key.plaintext_length), key.key_string_view(), key.score);
 
+    cipher::stats::report();
     std::println("done?");
 }
 
-int main(int, const char* argv[])
+struct drag_options
+{
+    std::string crib{};
+    // Best offsets printed.
+    std::size_t show{ 20 };
+    // Best offsets searched, with their key fragment as key pattern.
+    std::size_t search{ 0 };
+};
+
+template<typename tables, auto key_alphabet>
+static void drag_and_search(const drag_options& drag,
+                            const std::string_view plaintext,
+                            const std::string_view heuristic,
+                            const parallel_options& options,
+                            const shard_options& shards,
+                            const beam_options& beam)
+{
+    constexpr static auto key_char = [](const std::size_t ciphertext_index, const char base64_char) {
+        const auto c = implied_key_char<tables, ciphertext>(ciphertext_index, base64_char);
+        return std::find(key_alphabet.begin(), key_alphabet.end(), c) != key_alphabet.end() ? c : '\0';
+    };
+
+    const auto placements = cipher::bruteforce::drag_crib<key_char>(drag.crib, ciphertext.size() * 3 / 4, max_key_size, options.thread_count);
+    std::println("CRIB {} FITS AT {} OFFSETS", drag.crib, placements.size());
+    for(auto i = 0u; i < std::min(drag.show, placements.size()); i++)
+        std::println("OFFSET: {:5} PERIOD: {:3} AGREEMENTS: {:3} KEY: {}",
+                     placements[i].offset, placements[i].period, placements[i].agreements, placements[i].key);
+
+    for(auto i = 0u; i < std::min(drag.search, placements.size()); i++) {
+        std::println("SEARCHING KEY PATTERN {} (OFFSET {})", placements[i].key, placements[i].offset);
+        key_pattern.contents = placements[i].key;
+        // Every offset keeps its own checkpoint, so a restart resumes each one.
+        auto offset_options = options;
+        if (!offset_options.checkpoint_path.empty())
+            offset_options.checkpoint_path += ".offset-" + std::to_string(placements[i].offset);
+        bruteforce_key<tables, key_alphabet>(plaintext, heuristic, offset_options, shards, beam);
+    }
+}
+
+template<typename tables, auto key_alphabet>
+static void bruteforce_keys(const std::string_view heuristic, const bool require_all)
 {
-    bruteforce_key(std::string_view{ argv[1] });
+    base64_multi_key_bruteforce_state state{ ciphertexts.size(), require_all };
+
+    if (heuristic == "alphabet")
+        bruteforce_key_vigenere_multi<tables, max_key_size, key_alphabet, ciphertexts, in_alphabet_heuristic, batch_you_win, batch_progress_report>(state);
+    else if (heuristic == "ngram")
+        bruteforce_key_vigenere_multi<tables, max_key_size, key_alphabet, ciphertexts, ngram_heuristic, batch_you_win, batch_progress_report>(state);
+    else if (heuristic == "print")
+        bruteforce_key_vigenere_multi<tables, max_key_size, key_alphabet, ciphertexts, print_heuristic, batch_you_win, batch_progress_report>(state);
+    else
+        bruteforce_key_vigenere_multi<tables, max_key_size, key_alphabet, ciphertexts, common_print_heuristic, batch_you_win, batch_progress_report>(state);
+
+    std::println(stderr, "\nFOUND {} KEYS", batch_keys.size());
+    cipher::stats::report();
+    std::println("done?");
+}
+
+// Compiled-in alphabets get tables and key loops specialized at compile time.
+// Returns false when the alphabets have no specialization.
+template<auto vigenere_alphabet, auto key_alphabet, auto... others>
+static bool bruteforce_key_specialized(const std::string_view alphabet,
+                                       const std::string_view key_alphabet_string,
+                                       const std::string_view plaintext,
+                                       const std::string_view heuristic,
+                                       const bool require_all,
+                                       const drag_options& drag,
+                                       const parallel_options& options,
+                                       const shard_options& shards,
+                                       const beam_options& beam)
+{
+    if (alphabet == cipher::to_string(vigenere_alphabet) && key_alphabet_string == cipher::to_string(key_alphabet)) {
+        if (ciphertexts.size() > 1)
+            bruteforce_keys<static_vigenere_tables<vigenere_alphabet>, key_alphabet>(heuristic, require_all);
+        else if (!drag.crib.empty())
+            drag_and_search<static_vigenere_tables<vigenere_alphabet>, key_alphabet>(drag, plaintext, heuristic, options, shards, beam);
+        else
+            bruteforce_key<static_vigenere_tables<vigenere_alphabet>, key_alphabet>(plaintext, heuristic, options, shards, beam);
+        return true;
+    }
+    if constexpr (sizeof...(others) != 0)
+        return bruteforce_key_specialized<others...>(alphabet, key_alphabet_string, plaintext, heuristic, require_all, drag, options, shards, beam);
+    return false;
+}
+
+int main(int argc, const char* argv[])
+{
+    argparse::ArgumentParser parser("bruteforce_key");
+
+    parser.add_argument("-c", "--ciphertext")
+        .help("ciphertext to search, repeat to search several ciphertexts that share a key")
+        .append();
+    parser.add_argument("-f", "--ciphertext-file")
+        .help("read a ciphertext from a file, whitespace is ignored; can be repeated")
+        .append();
+    parser.add_argument("--all-targets")
+        .help("with several ciphertexts, only report keys that decode every one of them")
+        .flag()
+        .default_value(false);
+    parser.add_argument("-a", "--alphabet")
+        .default_value(std::string(cipher::to_string(giant_alphabet)));
+    parser.add_argument("-k", "--key-alphabet")
+        .default_value(std::string(cipher::to_string(letters_alphabet)));
+    parser.add_argument("-m", "--max-key-size")
+        .default_value(std::size_t{ 11 })
+        .scan<'u', std::size_t>();
+    parser.add_argument("--heuristic")
+        .choices("alphabet", "ngram", "print", "common")
+        .default_value(std::string("alphabet"));
+    parser.add_argument("-p", "--plaintext-alphabet")
+        .default_value(std::string("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 "));
+    parser.add_argument("--corpus")
+        .default_value(std::string("other/English.txt"));
+    parser.add_argument("--ngram-threshold")
+        .default_value(cipher::ngram::model<4>{}.threshold)
+        .scan<'g', float>();
+    parser.add_argument("--ngram-window")
+        .default_value(cipher::ngram::model<4>{}.window)
+        .scan<'u', std::size_t>();
+    parser.add_argument("--beam-width")
+        .help("search best-first, keeping at most this many partial keys ranked by n-gram score")
+        .default_value(std::size_t{ 0 })
+        .scan<'u', std::size_t>();
+    parser.add_argument("-s", "--specialized").flag().default_value(false);
+    parser.add_argument("-t", "--threads")
+        .default_value(cipher::parallel::default_thread_count())
+        .scan<'u', std::size_t>();
+    parser.add_argument("--split-depth")
+        .default_value(parallel_options{}.split_depth)
+        .scan<'u', std::size_t>();
+    parser.add_argument("--checkpoint")
+        .default_value(std::string());
+    parser.add_argument("--shard-socket")
+        .help("coordinate a search split over worker processes connecting to this unix socket")
+        .default_value(std::string());
+    parser.add_argument("--workers")
+        .help("worker processes the coordinator starts itself")
+        .default_value(std::size_t{ 0 })
+        .scan<'u', std::size_t>();
+    parser.add_argument("--shard-worker")
+        .help("connect to --shard-socket as a worker")
+        .flag()
+        .default_value(false);
+    parser.add_argument("--tasks-per-shard")
+        .default_value(shard_options{}.tasks_per_shard)
+        .scan<'u', std::size_t>();
+    parser.add_argument("--iterative")
+        .help("search with an explicit stack instead of recursion, for long ciphertexts")
+        .flag()
+        .default_value(false);
+    parser.add_argument("--key-pattern")
+        .help("search only keys of this length, with every character but '?' fixed")
+        .default_value(std::string());
+    parser.add_argument("--crib-drag")
+        .help("rank the offsets this crib may appear at by the key period they imply")
+        .default_value(std::string());
+    parser.add_argument("--drag-show")
+        .default_value(std::size_t{ 20 })
+        .scan<'u', std::size_t>();
+    parser.add_argument("--drag-search")
+        .help("search keys for this many of the best crib offsets")
+        .default_value(std::size_t{ 0 })
+        .scan<'u', std::size_t>();
+    parser.add_argument("--periods")
+        .help("estimate the key length and search only this many of the likeliest, best first")
+        .default_value(std::size_t{ 0 })
+        .scan<'u', std::size_t>();
+    parser.add_argument("--columns")
+        .help("instead of searching, fit each key character to its column and check this many of the best keys per key length")
+        .default_value(std::size_t{ 0 })
+        .scan<'u', std::size_t>();
+    parser.add_argument("plaintext")
+        .default_value(std::string());
+
+    try {
+        parser.parse_args(argc, argv);
+    } catch(const std::exception& e) {
+        std::println(stderr, "{}", e.what());
+        std::cerr << parser;
+        std::exit(1);
+    }
+
+    const auto alphabet = parser.get<std::string>("--alphabet");
+    if (alphabet.size() != 64) {
+        std::println(stderr, "alphabet must have 64 characters, got {}", alphabet.size());
+        std::exit(1);
+    }
+    // A repeated character would decode to two different values.
+    for(auto i = 0u; i < alphabet.size(); i++) {
+        if (const auto first = alphabet.find(alphabet[i]); first != i) {
+            std::println(stderr, "alphabet has '{}' at offsets {} and {}", alphabet[i], first, i);
+            std::exit(1);
+        }
+    }
+
+    ciphertexts.contents = parser.get<std::vector<std::string>>("--ciphertext");
+    for(const auto& path : parser.get<std::vector<std::string>>("--ciphertext-file")) {
+        std::ifstream file{ path };
+        if (!file) {
+            std::println(stderr, "failed to open ciphertext file {}", path);
+            std::exit(1);
+        }
+        std::string contents;
+        std::copy_if(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{}, std::back_inserter(contents),
+                     [](const char c) { return !std::isspace(static_cast<unsigned char>(c)); });
+        ciphertexts.contents.push_back(std::move(contents));
+    }
+    if (ciphertexts.contents.empty())
+        ciphertexts.contents.emplace_back(cipher::to_string(default_ciphertext));
+    // The search decodes whole quanta of alphabet characters. Padding is
+    // dropped, and so is a short last quantum, which only holds part of the last
+    // plaintext bytes.
+    for(auto target = 0u; target < ciphertexts.size(); target++) {
+        auto& text = ciphertexts.contents[target];
+        for(auto padding = 0; padding < 2 && alphabet.find('=') == std::string::npos && !text.empty() && text.back() == '='; padding++)
+            text.pop_back();
+        if (const auto invalid = text.find_first_not_of(alphabet); invalid != std::string::npos) {
+            std::println(stderr, "ciphertext {} has '{}' at offset {}, which is not in the alphabet", target, text[invalid], invalid);
+            std::exit(1);
+        }
+        if (text.size() % 4 == 1) {
+            std::println(stderr, "ciphertext {} is not base64, {} characters leave a single one after the last quantum", target, text.size());
+            std::exit(1);
+        }
+        if (text.size() % 4 != 0) {
+            std::println(stderr, "ignoring the last {} characters of ciphertext {}, a partial quantum", text.size() % 4, target);
+            text.resize(text.size() / 4 * 4);
+        }
+        if (text.empty()) {
+            std::println(stderr, "ciphertext {} is empty", target);
+            std::exit(1);
+        }
+    }
+    if (ciphertexts.size() > MAX_TARGETS) {
+        std::println(stderr, "at most {} ciphertexts can be searched at once, got {}", MAX_TARGETS, ciphertexts.size());
+        std::exit(1);
+    }
+    ciphertext.contents = ciphertexts[0];
+    if (ciphertexts.size() == 1 && ciphertext.size() > base64_key_bruteforce_state::MAX_CIPHERTEXT_SIZE) {
+        std::println(stderr, "ciphertext can be at most {} characters, got {}", base64_key_bruteforce_state::MAX_CIPHERTEXT_SIZE, ciphertext.size());
+        std::exit(1);
+    }
+    for(auto target = 0u; ciphertexts.size() > 1 && target < ciphertexts.size(); target++) {
+        if (ciphertexts[target].size() > base64_multi_key_bruteforce_state::MAX_CIPHERTEXT_SIZE) {
+            std::println(stderr, "with several ciphertexts each can be at most {} characters, ciphertext {} has {}",
+                         base64_multi_key_bruteforce_state::MAX_CIPHERTEXT_SIZE, target, ciphertexts[target].size());
+            std::exit(1);
+        }
+    }
+    key_alphabet.contents = parser.get<std::string>("--key-alphabet");
+    if (const auto invalid = key_alphabet.contents.find_first_not_of(alphabet); invalid != std::string::npos) {
+        std::println(stderr, "key alphabet has '{}' at offset {}, which is not in the alphabet", key_alphabet[invalid], invalid);
+        std::exit(1);
+    }
+    max_key_size.value = parser.get<std::size_t>("--max-key-size");
+    if (max_key_size.value > base64_key_bruteforce_state::MAX_KEY_SIZE) {
+        std::println(stderr, "max key size can be at most {}, got {}", base64_key_bruteforce_state::MAX_KEY_SIZE, max_key_size.value);
+        std::exit(1);
+    }
+    for(const auto c : parser.get<std::string>("--plaintext-alphabet"))
+        plaintext_alphabet[static_cast<std::uint8_t>(c)] = true;
+
+    parallel_options options;
+    options.thread_count = parser.get<std::size_t>("--threads");
+    options.split_depth = parser.get<std::size_t>("--split-depth");
+    options.checkpoint_path = parser.get<std::string>("--checkpoint");
+    options.iterative = parser.get<bool>("--iterative");
+
+    shard_options shards;
+    shards.socket_path = parser.get<std::string>("--shard-socket");
+    shards.local_workers = parser.get<std::size_t>("--workers");
+    shards.worker = parser.get<bool>("--shard-worker");
+    shards.tasks_per_shard = parser.get<std::size_t>("--tasks-per-shard");
+    if (shards.socket_path.empty() && (shards.worker || shards.local_workers != 0)) {
+        std::println(stderr, "--shard-worker and --workers need --shard-socket");
+        std::exit(1);
+    }
+
+    const auto plaintext = parser.get<std::string>("plaintext");
+    // Every known base64 character pins down one key character.
+    if (plaintext.size() * 4 / 3 > base64_key_bruteforce_state::MAX_KEY_SIZE || plaintext.size() > ciphertext.size() / 4 * 3) {
+        std::println(stderr, "known plaintext can be at most {} characters, got {}",
+                     std::min(base64_key_bruteforce_state::MAX_KEY_SIZE * 3 / 4, ciphertext.size() / 4 * 3), plaintext.size());
+        std::exit(1);
+    }
+    const auto heuristic = parser.get<std::string>("--heuristic");
+    const auto require_all = parser.get<bool>("--all-targets");
+    beam_options beam;
+    beam.width = parser.get<std::size_t>("--beam-width");
+
+    drag_options drag;
+    drag.crib = parser.get<std::string>("--crib-drag");
+    drag.show = parser.get<std::size_t>("--drag-show");
+    drag.search = parser.get<std::size_t>("--drag-search");
+    key_pattern.contents = parser.get<std::string>("--key-pattern");
+    if (key_pattern.size() > base64_key_bruteforce_state::MAX_KEY_SIZE) {
+        std::println(stderr, "key pattern can be at most {} characters, got {}", base64_key_bruteforce_state::MAX_KEY_SIZE, key_pattern.size());
+        std::exit(1);
+    }
+    for(auto i = 0u; i < key_pattern.size(); i++) {
+        if (key_pattern[i] != '?' && alphabet.find(key_pattern[i]) == std::string::npos) {
+            std::println(stderr, "key pattern has '{}' at offset {}, which is not in the alphabet", key_pattern[i], i);
+            std::exit(1);
+        }
+    }
+
+    if (ciphertexts.size() > 1 && (!plaintext.empty() || beam.width != 0 || !options.checkpoint_path.empty() || !shards.socket_path.empty()
+                                   || !drag.crib.empty() || key_pattern.size() != 0 || parser.get<std::size_t>("--periods") != 0)) {
+        std::println(stderr, "known plaintext, --beam-width, --checkpoint, --shard-socket, --crib-drag, --key-pattern and --periods need a single ciphertext");
+        std::exit(1);
+    }
+    column_keys.value = parser.get<std::size_t>("--columns");
+    if (column_keys != 0 && (ciphertexts.size() > 1 || heuristic == "ngram" || beam.width != 0 || !shards.socket_path.empty())) {
+        std::println(stderr, "--columns needs a single ciphertext and cannot be combined with --heuristic ngram, --beam-width or --shard-socket");
+        std::exit(1);
+    }
+    if (parser.get<std::size_t>("--periods") != 0 && (!drag.crib.empty() || key_pattern.size() != 0)) {
+        std::println(stderr, "--periods picks the key length itself, it cannot be combined with --crib-drag or --key-pattern");
+        std::exit(1);
+    }
+
+    if (heuristic == "ngram" || beam.width != 0) {
+        try {
+            language_model = cipher::ngram::model<4>::from_file(parser.get<std::string>("--corpus"));
+        } catch(const std::exception& e) {
+            std::println(stderr, "{}", e.what());
+            std::exit(1);
+        }
+        language_model.threshold = parser.get<float>("--ngram-threshold");
+        language_model.window = parser.get<std::size_t>("--ngram-window");
+        // The heuristic reads window + 3 characters back, and the search has
+        // written up to two characters past the one being checked.
+        if (language_model.window + 3 + 2 > base64_key_bruteforce_state::PLAINTEXT_WINDOW) {
+            std::println(stderr, "ngram window can be at most {}, got {}", base64_key_bruteforce_state::PLAINTEXT_WINDOW - 3 - 2, language_model.window);
+            std::exit(1);
+        }
+    }
+
+    for(const auto& parameter : { alphabet, key_alphabet.contents, std::to_string(max_key_size.value), parser.get<std::string>("--plaintext-alphabet"),
+                                  plaintext, heuristic, std::to_string(column_keys.value), std::to_string(parser.get<std::size_t>("--periods")),
+                                  std::to_string(parser.get<bool>("--specialized")), parser.get<std::string>("--corpus"),
+                                  std::to_string(language_model.threshold), std::to_string(language_model.window) }) {
+        options.search_parameters += parameter;
+        options.search_parameters += '\0';
+    }
+
+    const auto run_search = [&]() {
+        if (parser.get<bool>("--specialized")) {
+            if (!bruteforce_key_specialized<giant_alphabet, letters_alphabet,
+                                            giant_alphabet, cipher::base64::DEFAULT_ALPHABET,
+                                            cipher::base64::DEFAULT_ALPHABET, letters_alphabet,
+                                            cipher::base64::DEFAULT_ALPHABET, cipher::base64::DEFAULT_ALPHABET>(
+                    alphabet, key_alphabet.contents, plaintext, heuristic, require_all, drag, options, shards, beam)) {
+                std::println(stderr, "no specialized search for alphabet {} with key alphabet {}", alphabet, key_alphabet.contents);
+                std::exit(1);
+            }
+            return;
+        }
+
+        runtime_vigenere_tables::set(alphabet);
+        if (ciphertexts.size() > 1)
+            bruteforce_keys<runtime_vigenere_tables, key_alphabet>(heuristic, require_all);
+        else if (!drag.crib.empty())
+            drag_and_search<runtime_vigenere_tables, key_alphabet>(drag, plaintext, heuristic, options, shards, beam);
+        else
+            bruteforce_key<runtime_vigenere_tables, key_alphabet>(plaintext, heuristic, options, shards, beam);
+    };
+    // A checkpoint that cannot be resumed from is reported rather than searched
+    // over, since it may hold hours of work.
+    const auto search = [&]() {
+        try {
+            run_search();
+        } catch(const cipher::checkpoint::invalid_checkpoint& e) {
+            std::println(stderr, "{}; remove it to start the search over", e.what());
+            std::exit(1);
+        }
+    };
+
+    // Searches one key length at a time, most likely first. The ciphertext is
+    // base64, so its own period is 4.
+    const auto periods = parser.get<std::size_t>("--periods");
+    if (periods != 0) {
+        const auto ranked = cipher::period::rank(ciphertext.contents, cipher::alphabet::create_ascii_to_index_array(std::span{ alphabet }),
+                                                 alphabet.size(), max_key_size.value, 4);
+        for(auto i = 0u; i < std::min(periods, ranked.size()); i++)
+            std::println("PERIOD: {:3} COINCIDENCE: {:.3f} KASISKI: {:.3f}", ranked[i].period, ranked[i].coincidence, ranked[i].kasiski);
+        const auto checkpoint_path = options.checkpoint_path;
+        for(auto i = 0u; i < std::min(periods, ranked.size()); i++) {
+            std::println("SEARCHING PERIOD {}", ranked[i].period);
+            key_pattern.contents = std::string(ranked[i].period, '?');
+            // Every period keeps its own checkpoint, so a restart resumes each one.
+            if (!checkpoint_path.empty())
+                options.checkpoint_path = checkpoint_path.string() + ".period-" + std::to_string(ranked[i].period);
+            search();
+        }
+        return 0;
+    }
+
+    search();
     return 0;
 }
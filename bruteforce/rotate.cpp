@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <cstdint>
 #include <cstdio>
 #include <print>
 
@@ -6,6 +9,7 @@
 #include <cipher/base64.hpp>
 #include <cipher/cipher.hpp>
 #include <cipher/entropy.hpp>
+#include <cipher/period.hpp>
 #include <cipher/vigenere.hpp>
 #include <cipher/xor.hpp>
 
@@ -27,7 +31,7 @@ constexpr static auto create_rotated_alphabets()
 
 constexpr static auto create_ascii_to_indexes(const auto& alphabets)
 {
-    std::array<cipher::alphabet::ascii_to_index_t<VIGENERE_ALPHABET_SIZE>, VIGENERE_ALPHABET_SIZE> ret;
+    std::array<cipher::alphabet::ascii_to_index_t, VIGENERE_ALPHABET_SIZE> ret;
     for(auto i = 0u; i < VIGENERE_ALPHABET_SIZE; i++)
         ret[i] = cipher::alphabet::create_ascii_to_index_array(alphabets[i]);
     return ret;
@@ -41,29 +45,55 @@ constexpr static auto create_decoding_tables(const auto& alphabets, const auto&
     return ret;
 }
 
+// Decodes the ciphertext under every rotation at once, a base64 quantum at a
+// time. Bit k of the result is set when rotation k decodes to printable text;
+// a rotation is dropped at its first unprintable byte, and the search stops
+// once none is left.
 template<std::size_t cipher_len, typename charT>
-constexpr static bool rotate_vigenere(const std::span<const char, cipher_len> ciphertext, const std::span<charT> key)
+static std::uint64_t rotate_vigenere(const std::span<const char, cipher_len> ciphertext, const std::span<charT> key)
 {
+    static_assert(VIGENERE_ALPHABET_SIZE <= 64);
     constexpr static const auto rotated_alphabets = create_rotated_alphabets();
     constexpr static const auto ascii_to_indexes = create_ascii_to_indexes(rotated_alphabets);
-
-    for(auto k = 0u; k < VIGENERE_ALPHABET_SIZE; k++) {
-        auto vigenered = cipher::empty_buffer<cipher_len>();
-        cipher::vigenere::encode<false>(std::span{ vigenered },
-                                        std::span{ ciphertext },
-                                        key,
-                                        rotated_alphabets[k],
-                                        ascii_to_indexes[k]);
-
-        auto plaintext = cipher::empty_buffer<cipher_len * 3 / 4>();
-        cipher::base64::decode(std::span{ plaintext },
-                               std::span{ vigenered });
-
-        if (cipher::is_print(std::span{ plaintext })) [[unlikely]]
-            return true;
+    // 256KB of tables, built on first use: as a constant they take more
+    // evaluation steps than compilers allow by default.
+    static const auto decoding_tables = create_decoding_tables(rotated_alphabets, ascii_to_indexes);
+
+    const auto value = [&](const std::size_t rotation, const std::size_t index) {
+        const auto& ascii_to_index = ascii_to_indexes[rotation];
+        const auto source = static_cast<std::uint8_t>(ciphertext[index]);
+        const auto key_char = static_cast<std::uint8_t>(key[index % key.size()]);
+        const auto plain = decoding_tables[rotation][ascii_to_index[source]][ascii_to_index[key_char]];
+        return cipher::base64::DEFAULT_ASCII_TO_VALUE_ARRAY[static_cast<std::uint8_t>(plain)];
+    };
+
+    auto alive = ~std::uint64_t{ 0 } >> (64 - VIGENERE_ALPHABET_SIZE);
+    const auto size = cipher_len * 3 / 4;
+    // Byte j of a quantum is made of its base64 characters j and j + 1. Each
+    // rotation decodes a character once and carries it over to the next byte,
+    // stopping at the first byte that is not printable.
+    for(auto quantum = 0u; quantum * 3 < size && alive != 0; quantum++) {
+        const auto bytes = std::min<std::size_t>(3, size - quantum * 3);
+        for(auto rotations = alive; rotations != 0; rotations &= rotations - 1) {
+            const auto rotation = static_cast<std::size_t>(std::countr_zero(rotations));
+            auto previous = value(rotation, quantum * 4);
+            for(auto j = 0u; j < bytes; j++) {
+                const auto next = value(rotation, quantum * 4 + j + 1);
+                if (!cipher::is_print(static_cast<char>((previous << (2 + 2 * j)) | (next >> (4 - 2 * j))))) {
+                    alive &= ~(std::uint64_t{ 1 } << rotation);
+                    break;
+                }
+                previous = next;
+            }
+        }
     }
+    return alive;
+}
 
-    return false;
+static void print_rotations(const std::string_view key, const std::uint64_t rotations)
+{
+    for(auto left = rotations; left != 0; left &= left - 1)
+        std::println("KEY: {} ROTATION: {}", key, std::countr_zero(left));
 }
 
 // constexpr static const auto ciphertext = cipher::ciphertext(
@@ -82,29 +112,32 @@ static void make_key(char* key, std::size_t current_index, std::size_t size)
 {
     for(auto i = 0u; i < key_alphabet.size(); i++) {
         key[current_index] = key_alphabet[i];
-        if (rotate_vigenere(std::span{ ciphertext }, std::span{ key, size }))
-            std::println("KEY: {}", std::string_view { key, size });
+        print_rotations(std::string_view{ key, size }, rotate_vigenere(std::span{ ciphertext }, std::span{ key, size }));
         if (current_index + 1 < size)
             make_key(key, current_index + 1, size);
     }
 }
 
+// Key lengths 1 to 6, likeliest first. Rotating the alphabet does not change
+// which ciphertext characters match, so the columns can be compared in any one.
 static void bruteforce_key()
 {
-    for(auto i = 1u; i < 7; i++) {
+    const auto periods = cipher::period::rank(ciphertext,
+                                              cipher::alphabet::create_ascii_to_index_array(vigenere_alphabet),
+                                              VIGENERE_ALPHABET_SIZE, 6, 4);
+    for(const auto& estimate : periods) {
         char key[13]{ 0 };
         for(auto i = 0u; i < sizeof(key); i++)
             key[i] = key_alphabet[0];
-        std::println("Key length: {}", i);
-        make_key(key, 0, i);
+        std::println("Key length: {}", estimate.period);
+        make_key(key, 0, estimate.period);
     }
 }
 
 static void wordlist_key()
 {
     for(const auto key : keys)
-        rotate_vigenere(std::span{ ciphertext },
-                        std::span{ key });
+        print_rotations(key, rotate_vigenere(std::span{ ciphertext }, std::span{ key }));
 }
 
 int main(int argc, const char* argv[])
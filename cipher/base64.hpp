@@ -1,10 +1,20 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
 #include <span>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "alphabet.hpp"
 #include "cipher/cipher.hpp"
+#include "cipher/simd.hpp"
 
 namespace cipher::base64
 {
@@ -12,18 +22,325 @@ namespace cipher::base64
 constexpr static const auto DEFAULT_ALPHABET = alphabet::create("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/");
 constexpr static const auto DEFAULT_ASCII_TO_VALUE_ARRAY = alphabet::create_ascii_to_index_array(DEFAULT_ALPHABET);
 
+constexpr static const std::uint8_t INVALID = 0xff;
+
+// Like alphabet::create_ascii_to_index_array, but with INVALID for characters
+// outside the alphabet, for decode_checked.
+constexpr static alphabet::ascii_to_index_t create_checked_ascii_to_value_array(const alphabet::alphabet_t<64>& alphabet)
+{
+    alphabet::ascii_to_index_t ascii_to_value;
+    ascii_to_value.fill(INVALID);
+    for(std::uint8_t i = 0u; i < alphabet.size(); i++)
+        ascii_to_value[static_cast<std::uint8_t>(alphabet[i])] = i;
+    return ascii_to_value;
+}
+
+constexpr static const auto DEFAULT_CHECKED_ASCII_TO_VALUE_ARRAY = create_checked_ascii_to_value_array(DEFAULT_ALPHABET);
+
+// Characters needed for size bytes. Without padding a partial quantum takes
+// only the characters that hold some of its bits.
+constexpr static std::size_t encoded_size(const std::size_t size, const bool padding = true)
+{
+    return padding ? (size + 2) / 3 * 4 : (size * 4 + 2) / 3;
+}
+
+#if CIPHER_SIMD_X86
+
+// Vector encoding of whole quanta, the reverse of the above. Three bytes are
+// spread over 32 bits and their four 6-bit values moved into bytes with two
+// multiplies. The values pick characters from the alphabet as four 16-entry
+// shuffle tables, xored together the same way; a value only ever shuffles
+// negative, to 0, in the tables above its own, so any byte alphabet works. The
+// kernels return the number of bytes encoded, which leaves a whole number of
+// quanta.
+
+__attribute__((target("ssse3"))) inline std::size_t encode_ssse3(char* target, const std::uint8_t* source, const std::size_t size,
+                                                                 const alphabet::alphabet_t<64>& alphabet)
+{
+    __m128i to_char[4];
+    for(auto high = 0u; high < 4; high++)
+        to_char[high] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(alphabet.data() + 16 * high));
+    for(auto high = 3u; high > 0; high--)
+        to_char[high] = _mm_xor_si128(to_char[high], to_char[high - 1]);
+    const auto sixteen = _mm_set1_epi8(16);
+    const auto spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+
+    // 12 of every 16 bytes loaded are encoded.
+    std::size_t i{ 0 };
+    for(; i + 16 <= size; i += 12) {
+        const auto bytes = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)), spread);
+        const auto outer = _mm_mulhi_epu16(_mm_and_si128(bytes, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        const auto inner = _mm_mullo_epi16(_mm_and_si128(bytes, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        auto shifted = _mm_or_si128(outer, inner);
+        auto chars = _mm_shuffle_epi8(to_char[0], shifted);
+        for(auto h = 1; h < 4; h++) {
+            shifted = _mm_sub_epi8(shifted, sixteen);
+            chars = _mm_xor_si128(chars, _mm_shuffle_epi8(to_char[h], shifted));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i / 3 * 4), chars);
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) inline std::size_t encode_avx2(char* target, const std::uint8_t* source, const std::size_t size,
+                                                               const alphabet::alphabet_t<64>& alphabet)
+{
+    __m256i to_char[4];
+    for(auto high = 0u; high < 4; high++)
+        to_char[high] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(alphabet.data() + 16 * high)));
+    for(auto high = 3u; high > 0; high--)
+        to_char[high] = _mm256_xor_si256(to_char[high], to_char[high - 1]);
+    const auto sixteen = _mm256_set1_epi8(16);
+    const auto spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                         1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+
+    // 12 bytes per 128-bit lane.
+    std::size_t i{ 0 };
+    for(; i + 28 <= size; i += 24) {
+        const auto low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        const auto high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 12));
+        const auto bytes = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), spread);
+        const auto outer = _mm256_mulhi_epu16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        const auto inner = _mm256_mullo_epi16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        auto shifted = _mm256_or_si256(outer, inner);
+        auto chars = _mm256_shuffle_epi8(to_char[0], shifted);
+        for(auto h = 1; h < 4; h++) {
+            shifted = _mm256_sub_epi8(shifted, sixteen);
+            chars = _mm256_xor_si256(chars, _mm256_shuffle_epi8(to_char[h], shifted));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i / 3 * 4), chars);
+    }
+    return i;
+}
+
+#endif
+
+// Writes encoded_size(source.size(), padding) characters and returns that.
+// padding is a template argument so that fixed extents are checked against the
+// length it gives.
+template<bool padding = true, typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
+constexpr static std::size_t encode(
+    const std::span<charT, ex1> target,
+    const std::span<charT2, ex2> source,
+    const alphabet::alphabet_t<64>& alphabet = DEFAULT_ALPHABET)
+{
+    if constexpr (ex1 != std::dynamic_extent && ex2 != std::dynamic_extent)
+        static_assert(ex1 >= encoded_size(ex2, padding));
+    std::size_t done{ 0 };
+    if !consteval {
+#if CIPHER_SIMD_X86
+        static_assert(sizeof(charT) == 1 && sizeof(charT2) == 1);
+        auto* const out = reinterpret_cast<char*>(target.data());
+        const auto* const in = reinterpret_cast<const std::uint8_t*>(source.data());
+        if (simd::detect() >= simd::instruction_set::avx2)
+            done = encode_avx2(out, in, source.size(), alphabet);
+        else if (simd::detect() >= simd::instruction_set::ssse3)
+            done = encode_ssse3(out, in, source.size(), alphabet);
+#endif
+    }
+    auto i = done / 3;
+    for(; i < source.size() / 3; i++) {
+        const auto byte_1 = static_cast<std::uint8_t>(source[i * 3 + 0]);
+        const auto byte_2 = static_cast<std::uint8_t>(source[i * 3 + 1]);
+        const auto byte_3 = static_cast<std::uint8_t>(source[i * 3 + 2]);
+
+        target[i * 4 + 0] = static_cast<charT>(alphabet[byte_1 >> 2]);
+        target[i * 4 + 1] = static_cast<charT>(alphabet[(byte_1 & 0x03) << 4 | byte_2 >> 4]);
+        target[i * 4 + 2] = static_cast<charT>(alphabet[(byte_2 & 0x0f) << 2 | byte_3 >> 6]);
+        target[i * 4 + 3] = static_cast<charT>(alphabet[byte_3 & 0x3f]);
+    }
+
+    auto written = i * 4;
+    const auto left = source.size() - i * 3;
+    if (left != 0) {
+        const auto byte_1 = static_cast<std::uint8_t>(source[i * 3]);
+        const auto byte_2 = left == 2 ? static_cast<std::uint8_t>(source[i * 3 + 1]) : std::uint8_t{ 0 };
+        target[written++] = static_cast<charT>(alphabet[byte_1 >> 2]);
+        target[written++] = static_cast<charT>(alphabet[(byte_1 & 0x03) << 4 | byte_2 >> 4]);
+        if (left == 2)
+            target[written++] = static_cast<charT>(alphabet[(byte_2 & 0x0f) << 2]);
+        while(padding && written % 4 != 0)
+            target[written++] = static_cast<charT>('=');
+    }
+    return written;
+}
+
+// encode over a stream that comes in chunks of any size. Bytes short of a
+// quantum are held back until the next chunk, or finish.
+struct encoder
+{
+    alphabet::alphabet_t<64> alphabet{ DEFAULT_ALPHABET };
+    bool padding{ true };
+    std::array<std::uint8_t, 3> pending{};
+    std::size_t pending_size{ 0 };
+
+    // Writes at most encoded_size(source.size() + 2) characters and returns how
+    // many.
+    template<typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
+    constexpr std::size_t update(const std::span<charT, ex1> target, const std::span<charT2, ex2> source)
+    {
+        std::span<charT2> rest{ source };
+        std::size_t written{ 0 };
+        if (pending_size != 0) {
+            for(; pending_size < 3 && !rest.empty(); rest = rest.subspan(1))
+                pending[pending_size++] = static_cast<std::uint8_t>(rest[0]);
+            if (pending_size < 3)
+                return 0;
+            written = encode_pending(target, std::span{ pending });
+            pending_size = 0;
+        }
+        const auto whole = rest.size() / 3 * 3;
+        written += encode_pending(target.subspan(written), rest.first(whole));
+        for(auto i = whole; i < rest.size(); i++)
+            pending[pending_size++] = static_cast<std::uint8_t>(rest[i]);
+        return written;
+    }
+
+    // The held back bytes, as the end of the stream.
+    template<typename charT, std::size_t extent>
+    constexpr std::size_t finish(const std::span<charT, extent> target)
+    {
+        const auto written = encode_pending(target, std::span{ pending }.first(pending_size));
+        pending_size = 0;
+        return written;
+    }
+
+    // encode with padding as this stream has it.
+    template<typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
+    constexpr std::size_t encode_pending(const std::span<charT, ex1> target, const std::span<charT2, ex2> source) const
+    {
+        return padding ? encode<true>(target, source, alphabet) : encode<false>(target, source, alphabet);
+    }
+};
+
+#if CIPHER_SIMD_X86
+
+// Vector decoding of whole quanta, in the style of Muła and Lemire. Any
+// alphabet works: the values of the 128 ASCII characters are the first half of
+// ascii_to_value, looked up as eight 16-entry shuffle tables. Table h is
+// shuffled with the character minus 16h, which is negative, and so shuffles to
+// 0, for characters below 16h. With every table stored xored with the one
+// before, xoring all shuffles leaves the entry of the character's own table;
+// those above it only add garbage for characters from 128 up, which are masked
+// to 0 like the zeroed entries of ascii_to_value. The kernels return the number
+// of characters decoded.
+//
+// checked kernels take a table with INVALID for characters outside the
+// alphabet and make characters from 128 up INVALID too. They stop before the
+// first register holding one, so that the scalar loop can find its offset.
+
+template<bool checked>
+__attribute__((target("ssse3"))) static std::size_t decode_ssse3(std::uint8_t* target, const char* source, const std::size_t size,
+                                                                 const alphabet::ascii_to_index_t& ascii_to_value)
+{
+    __m128i to_value[8];
+    for(auto high = 0u; high < 8; high++)
+        to_value[high] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ascii_to_value.data() + 16 * high));
+    for(auto high = 7u; high > 0; high--)
+        to_value[high] = _mm_xor_si128(to_value[high], to_value[high - 1]);
+    const auto sixteen = _mm_set1_epi8(16);
+    const auto pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    std::size_t i{ 0 };
+    for(; i + 16 <= size; i += 16) {
+        const auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        auto shifted = chars;
+        auto values = _mm_shuffle_epi8(to_value[0], shifted);
+        for(auto h = 1; h < 8; h++) {
+            shifted = _mm_sub_epi8(shifted, sixteen);
+            values = _mm_xor_si128(values, _mm_shuffle_epi8(to_value[h], shifted));
+        }
+        if constexpr (checked) {
+            values = _mm_or_si128(_mm_cmplt_epi8(chars, _mm_setzero_si128()), values);
+            if (_mm_movemask_epi8(values) != 0)
+                break;
+        } else {
+            values = _mm_andnot_si128(_mm_cmplt_epi8(chars, _mm_setzero_si128()), values);
+        }
+
+        // Four 6-bit values to a 24-bit group per 32 bits, then the groups'
+        // bytes in order.
+        const auto pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        const auto groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        const auto bytes = _mm_shuffle_epi8(groups, pack);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(target + i / 4 * 3), bytes);
+        const auto last = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+        std::memcpy(target + i / 4 * 3 + 8, &last, 4);
+    }
+    return i;
+}
+
+template<bool checked>
+__attribute__((target("avx2"))) static std::size_t decode_avx2(std::uint8_t* target, const char* source, const std::size_t size,
+                                                               const alphabet::ascii_to_index_t& ascii_to_value)
+{
+    __m256i to_value[8];
+    for(auto high = 0u; high < 8; high++)
+        to_value[high] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ascii_to_value.data() + 16 * high)));
+    for(auto high = 7u; high > 0; high--)
+        to_value[high] = _mm256_xor_si256(to_value[high], to_value[high - 1]);
+    const auto sixteen = _mm256_set1_epi8(16);
+    const auto pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                       2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    std::size_t i{ 0 };
+    for(; i + 32 <= size; i += 32) {
+        const auto chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        auto shifted = chars;
+        auto values = _mm256_shuffle_epi8(to_value[0], shifted);
+        for(auto h = 1; h < 8; h++) {
+            shifted = _mm256_sub_epi8(shifted, sixteen);
+            values = _mm256_xor_si256(values, _mm256_shuffle_epi8(to_value[h], shifted));
+        }
+        if constexpr (checked) {
+            values = _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_setzero_si256(), chars), values);
+            if (_mm256_movemask_epi8(values) != 0)
+                break;
+        } else {
+            values = _mm256_andnot_si256(_mm256_cmpgt_epi8(_mm256_setzero_si256(), chars), values);
+        }
+
+        const auto pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        const auto groups = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        // 12 bytes per 128-bit lane, moved next to each other.
+        const auto bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(groups, pack), _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i / 4 * 3), _mm256_castsi256_si128(bytes));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(target + i / 4 * 3 + 16), _mm256_extracti128_si256(bytes, 1));
+    }
+    return i;
+}
+
+#endif
+
 template<typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
 constexpr static void decode(
     const std::span<charT, ex1> target,
     const std::span<charT2, ex2> source,
-    const alphabet::alphabet_t<64>& = DEFAULT_ALPHABET,
+    const alphabet::alphabet_t<64>& alphabet = DEFAULT_ALPHABET,
     const alphabet::ascii_to_index_t& ascii_to_value = DEFAULT_ASCII_TO_VALUE_ARRAY)
 {
-    if consteval {
-        static_assert(source.size() % 4 == 0);
-        static_assert(target.size() >= (source.size() * 3 / 4));
+    if constexpr (ex1 != std::dynamic_extent && ex2 != std::dynamic_extent) {
+        static_assert(ex2 % 4 == 0);
+        static_assert(ex1 >= ex2 * 3 / 4);
     }
-    for(auto i = 0u; i < source.size() / 4; i++) {
+    std::size_t done{ 0 };
+    if !consteval {
+#if CIPHER_SIMD_X86
+        static_assert(sizeof(charT) == 1 && sizeof(charT2) == 1);
+        // The tables only cover ASCII alphabets.
+        bool ascii{ true };
+        for(const auto c : alphabet)
+            ascii &= static_cast<std::uint8_t>(c) < 128;
+        auto* const out = reinterpret_cast<std::uint8_t*>(target.data());
+        const auto* const in = reinterpret_cast<const char*>(source.data());
+        const auto size = source.size() / 4 * 4;
+        if (ascii && simd::detect() >= simd::instruction_set::avx2)
+            done = decode_avx2<false>(out, in, size, ascii_to_value);
+        else if (ascii && simd::detect() >= simd::instruction_set::ssse3)
+            done = decode_ssse3<false>(out, in, size, ascii_to_value);
+#endif
+    }
+    for(auto i = done / 4; i < source.size() / 4; i++) {
         const auto char_1 = ascii_to_value[static_cast<std::uint8_t>(source[i * 4 + 0])];
         const auto char_2 = ascii_to_value[static_cast<std::uint8_t>(source[i * 4 + 1])];
         const auto char_3 = ascii_to_value[static_cast<std::uint8_t>(source[i * 4 + 2])];
@@ -35,24 +352,352 @@ constexpr static void decode(
     }
 }
 
+struct decode_result
+{
+    // Bytes written to the target.
+    std::size_t size{ 0 };
+    // Offset in the source of the first character that cannot be there.
+    std::optional<std::size_t> invalid{};
+};
+
+constexpr static bool is_ascii(const alphabet::alphabet_t<64>& alphabet)
+{
+    bool ascii{ true };
+    for(const auto c : alphabet)
+        ascii &= static_cast<std::uint8_t>(c) < 128;
+    return ascii;
+}
+
+// Decodes the whole quanta at the start of source, up to the first one with a
+// character outside the alphabet, and returns the characters read. The vector
+// kernels need an ascii alphabet, see is_ascii.
+template<typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
+constexpr static std::size_t decode_valid_quanta(
+    const std::span<charT, ex1> target,
+    const std::span<charT2, ex2> source,
+    const alphabet::ascii_to_index_t& checked_ascii_to_value,
+    [[maybe_unused]] const bool ascii)
+{
+    std::size_t done{ 0 };
+    if !consteval {
+#if CIPHER_SIMD_X86
+        static_assert(sizeof(charT) == 1 && sizeof(charT2) == 1);
+        auto* const out = reinterpret_cast<std::uint8_t*>(target.data());
+        const auto* const in = reinterpret_cast<const char*>(source.data());
+        const auto size = source.size() / 4 * 4;
+        if (ascii && simd::detect() >= simd::instruction_set::avx2)
+            done = decode_avx2<true>(out, in, size, checked_ascii_to_value);
+        else if (ascii && simd::detect() >= simd::instruction_set::ssse3)
+            done = decode_ssse3<true>(out, in, size, checked_ascii_to_value);
+#endif
+    }
+
+    auto i = done;
+    for(; i + 4 <= source.size(); i += 4) {
+        const auto char_1 = checked_ascii_to_value[static_cast<std::uint8_t>(source[i + 0])];
+        const auto char_2 = checked_ascii_to_value[static_cast<std::uint8_t>(source[i + 1])];
+        const auto char_3 = checked_ascii_to_value[static_cast<std::uint8_t>(source[i + 2])];
+        const auto char_4 = checked_ascii_to_value[static_cast<std::uint8_t>(source[i + 3])];
+        if ((char_1 | char_2 | char_3 | char_4) >= 64)
+            break;
+
+        target[i / 4 * 3 + 0] = static_cast<charT>((char_1 << 2) + ((char_2 & 0x30) >> 4));
+        target[i / 4 * 3 + 1] = static_cast<charT>(((char_2 & 0x0f) << 4) + ((char_3 & 0x3c) >> 2));
+        target[i / 4 * 3 + 2] = static_cast<charT>(((char_3 & 0x03) << 6) + char_4);
+    }
+    return i;
+}
+
+// decode for input that is not known to be base64. The last quantum may be
+// padded with '=' or cut short to two or three characters; the target needs
+// source.size() * 3 / 4 bytes. Decoding stops at the first character outside
+// the alphabet, a padding character anywhere else, or a lone last character.
+template<typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
+constexpr static decode_result decode_checked(
+    const std::span<charT, ex1> target,
+    const std::span<charT2, ex2> source,
+    const alphabet::alphabet_t<64>& alphabet = DEFAULT_ALPHABET,
+    const alphabet::ascii_to_index_t& checked_ascii_to_value = DEFAULT_CHECKED_ASCII_TO_VALUE_ARRAY)
+{
+    if constexpr (ex1 != std::dynamic_extent && ex2 != std::dynamic_extent)
+        static_assert(ex1 >= ex2 * 3 / 4);
+    auto end = source.size();
+    if (end % 4 == 0)
+        for(auto padding = 0; padding < 2 && end != 0 && source[end - 1] == '='; padding++)
+            end--;
+
+    const auto i = decode_valid_quanta(target, source.first(end), checked_ascii_to_value, is_ascii(alphabet));
+    decode_result result{ i / 4 * 3 };
+
+    // The short last quantum, or the one with the invalid character.
+    std::array<std::uint8_t, 4> values{};
+    const auto count = std::min<std::size_t>(4, end - i);
+    for(auto j = 0u; j < count; j++) {
+        values[j] = checked_ascii_to_value[static_cast<std::uint8_t>(source[i + j])];
+        if (values[j] == INVALID) {
+            result.invalid = i + j;
+            return result;
+        }
+    }
+    if (count == 1)
+        result.invalid = i;
+    if (count < 2)
+        return result;
+    target[result.size++] = static_cast<charT>((values[0] << 2) + ((values[1] & 0x30) >> 4));
+    if (count > 2)
+        target[result.size++] = static_cast<charT>(((values[1] & 0x0f) << 4) + ((values[2] & 0x3c) >> 2));
+    return result;
+}
+
+constexpr static bool is_whitespace(const char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+#if CIPHER_SIMD_X86
+
+// Whitespace removal a register at a time. A register without whitespace is
+// stored as is. One with some is stored, and then for every whitespace
+// character the rest of the register is stored again one place further back.
+// Only reads and writes up to a register past the current one, so the kernels
+// stop a register short of the end. They return the characters read and
+// written.
+
+__attribute__((target("ssse3"))) inline std::pair<std::size_t, std::size_t> strip_whitespace_ssse3(char* target, const char* source, const std::size_t size)
+{
+    std::size_t i{ 0 };
+    std::size_t written{ 0 };
+    for(; i + 32 <= size; i += 16) {
+        const auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        const auto control = _mm_sub_epi8(chars, _mm_set1_epi8('\t'));
+        const auto whitespace = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+                                             _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control));
+        const auto found = static_cast<std::uint32_t>(_mm_movemask_epi8(whitespace));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + written), chars);
+        auto removed = 0u;
+        for(auto mask = found; mask != 0; mask &= mask - 1, removed++) {
+            const auto position = static_cast<std::size_t>(std::countr_zero(mask));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(target + written + position - removed),
+                             _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + position + 1)));
+        }
+        written += 16 - removed;
+    }
+    return { i, written };
+}
+
+__attribute__((target("avx2"))) inline std::pair<std::size_t, std::size_t> strip_whitespace_avx2(char* target, const char* source, const std::size_t size)
+{
+    std::size_t i{ 0 };
+    std::size_t written{ 0 };
+    for(; i + 64 <= size; i += 32) {
+        const auto chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        const auto control = _mm256_sub_epi8(chars, _mm256_set1_epi8('\t'));
+        const auto whitespace = _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')),
+                                                _mm256_cmpeq_epi8(_mm256_min_epu8(control, _mm256_set1_epi8('\r' - '\t')), control));
+        const auto found = static_cast<std::uint32_t>(_mm256_movemask_epi8(whitespace));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + written), chars);
+        auto removed = 0u;
+        for(auto mask = found; mask != 0; mask &= mask - 1, removed++) {
+            const auto position = static_cast<std::size_t>(std::countr_zero(mask));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + written + position - removed),
+                                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + position + 1)));
+        }
+        written += 32 - removed;
+    }
+    return { i, written };
+}
+
+#endif
+
+// Copies source to target without whitespace and returns the characters
+// copied.
+template<typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
+constexpr static std::size_t strip_whitespace(const std::span<charT, ex1> target, const std::span<charT2, ex2> source)
+{
+    std::size_t read{ 0 };
+    std::size_t written{ 0 };
+    if !consteval {
+#if CIPHER_SIMD_X86
+        static_assert(sizeof(charT) == 1 && sizeof(charT2) == 1);
+        auto* const out = reinterpret_cast<char*>(target.data());
+        const auto* const in = reinterpret_cast<const char*>(source.data());
+        if (simd::detect() >= simd::instruction_set::avx2)
+            std::tie(read, written) = strip_whitespace_avx2(out, in, source.size());
+        else if (simd::detect() >= simd::instruction_set::ssse3)
+            std::tie(read, written) = strip_whitespace_ssse3(out, in, source.size());
+#endif
+    }
+    for(; read < source.size(); read++)
+        if (!is_whitespace(static_cast<char>(source[read])))
+            target[written++] = static_cast<charT>(source[read]);
+    return written;
+}
+
+// decode_checked over a stream that comes in chunks of any size, with
+// whitespace anywhere, as in wrapped lines. Each chunk has its whitespace
+// stripped and is then decoded in one go; characters short of a quantum are
+// held back until the next chunk, or finish. Offsets count every character
+// taken, whitespace too.
+struct decoder
+{
+    alphabet::ascii_to_index_t checked_ascii_to_value;
+    bool ascii;
+    std::array<char, 4> pending{};
+    std::size_t pending_size{ 0 };
+    std::size_t pending_offset{ 0 };
+    // After padding only more '=', up to padding_left, and whitespace may come.
+    bool padded{ false };
+    std::size_t padding_left{ 0 };
+    std::size_t offset{ 0 };
+    std::optional<std::size_t> invalid{};
+    std::vector<char> buffer;
+
+    constexpr decoder(const alphabet::alphabet_t<64>& alphabet = DEFAULT_ALPHABET)
+        : checked_ascii_to_value{ create_checked_ascii_to_value_array(alphabet) },
+          ascii{ is_ascii(alphabet) }
+    {
+    }
+
+    // Writes at most (source.size() + 3) / 4 * 3 bytes. Once a character
+    // cannot be there, this and every later call return its offset.
+    template<typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
+    constexpr decode_result update(const std::span<charT, ex1> target, const std::span<charT2, ex2> source)
+    {
+        decode_result result{ 0, invalid };
+        if (invalid)
+            return result;
+        if (padded) {
+            for(auto i = 0u; i < source.size() && !invalid; i++)
+                take_padding(static_cast<char>(source[i]), offset + i);
+            offset += source.size();
+            result.invalid = invalid;
+            return result;
+        }
+
+        const auto carried = pending_size;
+        buffer.resize(carried + source.size());
+        std::copy_n(pending.begin(), carried, buffer.begin());
+        const auto size = carried + strip_whitespace(std::span{ buffer }.subspan(carried), source);
+        const auto read = decode_valid_quanta(target, std::span{ buffer }.first(size / 4 * 4), checked_ascii_to_value, ascii);
+        result.size = read / 4 * 3;
+
+        // Where buffer[index] came from in the stream, counted back from the
+        // end of the source.
+        const auto offset_of = [&](const std::size_t index) {
+            auto position = source.size();
+            for(auto after = size - index; after != 0;)
+                if (!is_whitespace(static_cast<char>(source[--position])))
+                    after--;
+            return offset + position;
+        };
+
+        // The characters after the whole quanta, or from the quantum that
+        // holds padding or an invalid character on.
+        pending_size = 0;
+        for(auto i = read; i < size && !invalid; i++) {
+            const auto c = buffer[i];
+            if (padded) {
+                take_padding(c, offset_of(i));
+            } else if (checked_ascii_to_value[static_cast<std::uint8_t>(c)] != INVALID) {
+                if (pending_size == 0 && i >= carried)
+                    pending_offset = offset_of(i);
+                pending[pending_size++] = c;
+                if (pending_size == 4)
+                    flush(target, result);
+            } else if (c == '=' && pending_size >= 2) {
+                padding_left = 3 - pending_size;
+                padded = true;
+                flush(target, result);
+            } else {
+                invalid = offset_of(i);
+            }
+        }
+        offset += source.size();
+        result.invalid = invalid;
+        return result;
+    }
+
+    // The held back characters, as the end of the stream.
+    template<typename charT, std::size_t extent>
+    constexpr decode_result finish(const std::span<charT, extent> target)
+    {
+        decode_result result{ 0, invalid };
+        if (!invalid && pending_size == 1)
+            invalid = pending_offset;
+        else if (!invalid)
+            flush(target, result);
+        result.invalid = invalid;
+        return result;
+    }
+
+    template<typename charT, std::size_t extent>
+    constexpr void flush(const std::span<charT, extent> target, decode_result& result)
+    {
+        std::array<std::uint8_t, 4> values{};
+        for(auto i = 0u; i < pending_size; i++)
+            values[i] = checked_ascii_to_value[static_cast<std::uint8_t>(pending[i])];
+        if (pending_size >= 2)
+            target[result.size++] = static_cast<charT>((values[0] << 2) + ((values[1] & 0x30) >> 4));
+        if (pending_size >= 3)
+            target[result.size++] = static_cast<charT>(((values[1] & 0x0f) << 4) + ((values[2] & 0x3c) >> 2));
+        if (pending_size == 4)
+            target[result.size++] = static_cast<charT>(((values[2] & 0x03) << 6) + values[3]);
+        pending_size = 0;
+    }
+
+    constexpr void take_padding(const char c, const std::size_t at)
+    {
+        if (c == '=' && padding_left != 0)
+            padding_left--;
+        else if (!is_whitespace(c))
+            invalid = at;
+    }
+};
+
+// A table per compiled-in alphabet, instead of a scan through the alphabet for
+// every character.
+template<auto alphabet>
+constexpr static const auto ascii_to_value_array = alphabet::create_ascii_to_index_array(alphabet);
+
 template<auto alphabet, typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
 constexpr static void decode(const std::span<charT, ex1> target,
                              const std::span<charT2, ex2> source)
 {
-    if consteval {
-        static_assert(source.size() % 4 == 0);
-        static_assert(target.size() >= (source.size() * 3 / 4));
-    }
-    for(auto i = 0u; i < source.size() / 4; i++) {
-        const auto char_1 = cipher::index_in_alphabet<alphabet>(source[i * 4 + 0]);
-        const auto char_2 = cipher::index_in_alphabet<alphabet>(source[i * 4 + 1]);
-        const auto char_3 = cipher::index_in_alphabet<alphabet>(source[i * 4 + 2]);
-        const auto char_4 = cipher::index_in_alphabet<alphabet>(source[i * 4 + 3]);
+    decode(target, source, alphabet, ascii_to_value_array<alphabet>);
+}
 
-        target[i * 3 + 0] = static_cast<charT>((char_1 << 2) + ((char_2 & 0x30) >> 4));
-        target[i * 3 + 1] = static_cast<charT>(((char_2 & 0x0f) << 4) + ((char_3 & 0x3c) >> 2));
-        target[i * 3 + 2] = static_cast<charT>(((char_3 & 0x03) << 6) + char_4);
+// Decoding one character at a time, as a search does. The character at phase
+// 0 to 3 of a quantum adds finish to the low bits of byte phase - 1, whose
+// high bits the characters before it set, which completes that byte for
+// phases 1 to 3. For phases 0 to 2 it also starts byte phase with start.
+struct decode_step
+{
+    std::uint8_t finish;
+    std::uint8_t start;
+};
+
+using decode_steps_t = std::array<std::array<decode_step, 256>, 4>;
+
+constexpr static decode_steps_t create_decode_steps(const alphabet::alphabet_t<64>& alphabet)
+{
+    decode_steps_t steps{};
+    for(std::uint8_t value = 0u; value < alphabet.size(); value++) {
+        const auto c = static_cast<std::uint8_t>(alphabet[value]);
+        steps[0][c] = { 0, static_cast<std::uint8_t>(value << 2) };
+        steps[1][c] = { static_cast<std::uint8_t>(value >> 4), static_cast<std::uint8_t>((value & 0x0f) << 4) };
+        steps[2][c] = { static_cast<std::uint8_t>(value >> 2), static_cast<std::uint8_t>((value & 0x03) << 6) };
+        steps[3][c] = { value, 0 };
     }
+    return steps;
+}
+
+template<auto alphabet>
+constexpr static const auto decode_steps = create_decode_steps(alphabet);
+
+template<auto alphabet = DEFAULT_ALPHABET>
+constexpr static decode_step decode_char(const std::size_t phase, const char c)
+{
+    return decode_steps<alphabet>[phase][static_cast<std::uint8_t>(c)];
 }
 
 }
@@ -1,29 +1,67 @@
+#pragma once
+
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <print>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <cipher/alphabet.hpp>
 #include <cipher/base64.hpp>
+#include <cipher/checkpoint.hpp>
 #include <cipher/cipher.hpp>
+#include <cipher/parallel.hpp>
+#include <cipher/shard.hpp>
+#include <cipher/stats.hpp>
 #include <cipher/vigenere.hpp>
 
 namespace cipher::bruteforce
 {
 
+// Keeps the whole plaintext, so the buffers are sized for the ciphertext the
+// search runs on.
+template<std::size_t MAX_CIPHERTEXT_SIZE>
 struct base64_alphabet_bruteforce_state
 {
     std::size_t plaintext_index{ 0 };
     std::size_t ciphertext_index{ 0 };
     std::size_t base64_plaintext_index{ 0 };
     cipher::alphabet::alphabet_t<64> alphabet;
-    std::array<bool, 64> available_characters;
+    // Bit i is set while alphabet[i] has no character yet.
+    std::uint64_t free_slots{ ~std::uint64_t{ 0 } };
+    // Bit c is set once character c is somewhere in the alphabet.
+    std::array<std::uint64_t, 4> used_characters{};
     cipher::alphabet::ascii_to_index_t ascii_to_index;
-    char plaintext[256]{ 0 };
-    char base64_plaintext[256]{ 0 };
+    // A quantum writes up to three plaintext and four base64 characters past the
+    // current index.
+    char plaintext[MAX_CIPHERTEXT_SIZE / 4 * 3 + 3]{ 0 };
+    char base64_plaintext[MAX_CIPHERTEXT_SIZE + 4]{ 0 };
 
     constexpr base64_alphabet_bruteforce_state()
     {
-        for(auto& b : available_characters)   b = true;
         for(auto& b : ascii_to_index)         b = static_cast<std::uint8_t>(-1);
         for(auto& b : alphabet)               b = '_';
     }
@@ -33,35 +71,69 @@ struct base64_alphabet_bruteforce_state
         return std::string_view{ plaintext, plaintext_index };
     }
 
+    constexpr bool is_free(const std::uint8_t index) const
+    {
+        return (free_slots >> index) & 1;
+    }
+
     constexpr void alloc(const std::uint8_t index, const char c)
     {
-        available_characters[index] = false;
+        const auto u = static_cast<std::uint8_t>(c);
+        free_slots &= ~(std::uint64_t{ 1 } << index);
+        used_characters[u / 64] |= std::uint64_t{ 1 } << (u % 64);
         alphabet[index] = c;
-        ascii_to_index[static_cast<std::uint8_t>(c)] = index;
+        ascii_to_index[u] = index;
     }
 
     constexpr void dealloc(const std::uint8_t index)
     {
-        ascii_to_index[static_cast<std::uint8_t>(alphabet[index])] = static_cast<std::uint8_t>(-1);
-        available_characters[index] = true;
+        const auto u = static_cast<std::uint8_t>(alphabet[index]);
+        ascii_to_index[u] = static_cast<std::uint8_t>(-1);
+        used_characters[u / 64] &= ~(std::uint64_t{ 1 } << (u % 64));
+        free_slots |= std::uint64_t{ 1 } << index;
         alphabet[index] = '_';
     }
 
+    // What get_next_char chose for a candidate, kept by the iterative search in
+    // place of the whole state.
+    struct choice
+    {
+        std::uint64_t free_slots;
+        cipher::alphabet::alphabet_t<64> alphabet;
+    };
+
+    constexpr choice current_choice() const
+    {
+        return { free_slots, alphabet };
+    }
+
+    // Frees what the choice does not hold before allocating, so no character is
+    // in two slots in between.
+    constexpr void restore(const choice& c)
+    {
+        for(auto slots = ~free_slots; slots != 0; slots &= slots - 1) {
+            const auto i = static_cast<std::uint8_t>(std::countr_zero(slots));
+            if (((c.free_slots >> i) & 1) != 0 || c.alphabet[i] != alphabet[i])
+                dealloc(i);
+        }
+        for(auto slots = free_slots & ~c.free_slots; slots != 0; slots &= slots - 1) {
+            const auto i = static_cast<std::uint8_t>(std::countr_zero(slots));
+            alloc(i, c.alphabet[i]);
+        }
+    }
+
     constexpr void add_to_alphabet(const std::string_view letters)
     {
-        for(std::uint8_t i = 0u; i < letters.length(); i++) {
-            for(std::uint8_t j = 0u; j < available_characters.size(); j++) {
-                if (!available_characters[j])
-                    continue;
-                alloc(j, letters[i]);
-                break;
-            }
+        for(const char c : letters) {
+            if (free_slots == 0)
+                return;
+            alloc(static_cast<std::uint8_t>(std::countr_zero(free_slots)), c);
         }
     }
 
     constexpr void try_alloc(const std::uint8_t index, const char c)
     {
-        if (available_characters[index])
+        if (is_free(index))
             alloc(index, c);
     }
 
@@ -72,29 +144,38 @@ struct base64_alphabet_bruteforce_state
             return;
         }
 
-        for(std::uint8_t i = 0u; i < available_characters.size(); i++) {
-            if (!available_characters[i])
-                continue;
+        for(auto slots = free_slots; slots != 0; slots &= slots - 1) {
+            const auto i = static_cast<std::uint8_t>(std::countr_zero(slots));
             alloc(i, c);
             then(c);
             dealloc(i);
         }
     }
 
+    // Tries every character of alphabet that is not used yet at index, in
+    // ascending character order.
     template<auto alphabet>
     constexpr void alloc_all_char_at_index(const std::uint8_t i, const auto& then)
     {
-        if (!available_characters[i]) {
-            then(alphabet[i]);
+        if (!is_free(i)) {
+            then(this->alphabet[i]);
             return;
         }
 
-        for(const char c : alphabet) {
-            if (ascii_to_index[static_cast<std::uint8_t>(c)] != static_cast<std::uint8_t>(-1))
-                continue;
-            alloc(i, c);
-            then(c);
-            dealloc(i);
+        constexpr static auto alphabet_characters = [] {
+            std::array<std::uint64_t, 4> mask{};
+            for(const char c : alphabet)
+                mask[static_cast<std::uint8_t>(c) / 64] |= std::uint64_t{ 1 } << (static_cast<std::uint8_t>(c) % 64);
+            return mask;
+        }();
+
+        for(auto word = 0u; word < used_characters.size(); word++) {
+            for(auto candidates = alphabet_characters[word] & ~used_characters[word]; candidates != 0; candidates &= candidates - 1) {
+                const auto c = static_cast<char>(word * 64 + static_cast<unsigned>(std::countr_zero(candidates)));
+                alloc(i, c);
+                then(c);
+                dealloc(i);
+            }
         }
     }
 
@@ -111,22 +192,216 @@ struct base64_alphabet_bruteforce_state
     {
         return std::string_view{ alphabet.begin(), alphabet.end() };
     }
+
+    void save(cipher::checkpoint::writer& w) const
+    {
+        w.put(static_cast<std::uint32_t>(plaintext_index));
+        w.put(static_cast<std::uint32_t>(ciphertext_index));
+        w.put(static_cast<std::uint32_t>(base64_plaintext_index));
+        w.put(free_slots);
+        w.put_bytes(alphabet.data(), alphabet.size());
+        w.put_bytes(plaintext, std::min<std::size_t>(plaintext_index + 3, sizeof(plaintext)));
+        w.put_bytes(base64_plaintext, std::min<std::size_t>(base64_plaintext_index + 4, sizeof(base64_plaintext)));
+    }
+
+    static base64_alphabet_bruteforce_state load(cipher::checkpoint::reader& r)
+    {
+        base64_alphabet_bruteforce_state a;
+        a.plaintext_index = r.get<std::uint32_t>();
+        a.ciphertext_index = r.get<std::uint32_t>();
+        a.base64_plaintext_index = r.get<std::uint32_t>();
+        const auto available = r.get<std::uint64_t>();
+        cipher::alphabet::alphabet_t<64> alphabet;
+        if (r.get_bytes(alphabet.data(), alphabet.size()) != alphabet.size())
+            throw cipher::checkpoint::invalid_checkpoint("corrupt checkpoint");
+        for(std::uint8_t i = 0u; i < alphabet.size(); i++)
+            if ((available & (std::uint64_t{ 1 } << i)) == 0)
+                a.alloc(i, alphabet[i]);
+        r.get_bytes(a.plaintext, sizeof(a.plaintext));
+        r.get_bytes(a.base64_plaintext, sizeof(a.base64_plaintext));
+        return a;
+    }
+};
+
+// The last N characters of a growing text, indexed by their position in the
+// whole text. N is a power of two so the index wraps with a mask.
+template<std::size_t N>
+struct text_window
+{
+    static_assert(std::has_single_bit(N));
+
+    char data[N]{ 0 };
+
+    constexpr char& operator[](const std::size_t index) { return data[index % N]; }
+    constexpr char operator[](const std::size_t index) const { return data[index % N]; }
 };
 
+// Small enough to stay in L1 per thread and to be copied around by the frontier,
+// the beam and the shards. The plaintext is not kept beyond what the heuristics
+// look back at: it follows from the key, see key_plaintext.
 struct base64_key_bruteforce_state
 {
+    constexpr static const std::size_t MAX_KEY_SIZE = 64;
+    constexpr static const std::size_t PLAINTEXT_WINDOW = 64;
+    constexpr static const std::size_t MAX_CIPHERTEXT_SIZE = UINT16_MAX;
+
+    bool trying_repeat{ false };
+    std::uint8_t key_index{ 0 };
+    std::uint16_t plaintext_index{ 0 };
+    std::uint16_t ciphertext_index{ 0 };
+    char key[MAX_KEY_SIZE]{ 0 };
+    text_window<PLAINTEXT_WINDOW> plaintext{};
+
+    constexpr std::string_view key_string_view() const
+    {
+        return std::string_view{ key, key_index };
+    }
+
+    void save(cipher::checkpoint::writer& w) const
+    {
+        w.put(trying_repeat);
+        w.put(plaintext_index);
+        w.put(ciphertext_index);
+        w.put_bytes(key, key_index);
+        w.put_bytes(plaintext.data, sizeof(plaintext.data));
+    }
+
+    static base64_key_bruteforce_state load(cipher::checkpoint::reader& r)
+    {
+        base64_key_bruteforce_state a;
+        a.trying_repeat = r.get<bool>();
+        a.plaintext_index = r.get<std::uint16_t>();
+        a.ciphertext_index = r.get<std::uint16_t>();
+        a.key_index = static_cast<std::uint8_t>(r.get_bytes(a.key, sizeof(a.key)));
+        r.get_bytes(a.plaintext.data, sizeof(a.plaintext.data));
+        return a;
+    }
+
+    constexpr void alloc(const char c)
+    {
+        assert(key_index < MAX_KEY_SIZE);
+        key[key_index++] = c;
+    }
+
+    constexpr void dealloc()
+    {
+        key[--key_index] = 0;
+    }
+
+    // What get_next_char chose for a candidate, kept by the iterative search in
+    // place of the whole state.
+    struct choice
+    {
+        std::uint8_t key_index;
+        bool trying_repeat;
+        char last_key_char;
+    };
+
+    constexpr choice current_choice() const
+    {
+        return { key_index, trying_repeat, key_index == 0 ? '\0' : key[key_index - 1] };
+    }
+
+    // The key of a choice extends the key of the candidate's parent, which this
+    // state's key does as well.
+    constexpr void restore(const choice& c)
+    {
+        while(key_index > c.key_index)
+            dealloc();
+        if (key_index < c.key_index)
+            alloc(c.last_key_char);
+        else if (key_index != 0)
+            key[key_index - 1] = c.last_key_char;
+        trying_repeat = c.trying_repeat;
+    }
+
+    template<auto alphabet, auto then>
+    constexpr void new_char()
+    {
+        for(const char c : alphabet) {
+            alloc(c);
+            then(*this);
+            dealloc();
+        }
+    }
+};
+
+// What a key search keeps of a hit.
+struct key_hit
+{
+    std::uint8_t key_length{ 0 };
+    std::uint16_t plaintext_length{ 0 };
+    float score{ 0 };
+    char key[base64_key_bruteforce_state::MAX_KEY_SIZE]{ 0 };
+
+    static key_hit of(const base64_key_bruteforce_state& state, const float score)
+    {
+        key_hit hit{ state.key_index, state.plaintext_index, score };
+        std::copy_n(state.key, state.key_index, hit.key);
+        return hit;
+    }
+
+    constexpr std::string_view key_string_view() const
+    {
+        return std::string_view{ key, key_length };
+    }
+};
+
+// Decodes the ciphertext again with a key to get the plaintext that a key state
+// no longer holds. decode(key, index) returns the base64 character at ciphertext
+// index, as the search decoded it. Only the first plaintext_length bytes are
+// returned.
+template<auto decode>
+static std::string key_plaintext(const std::string_view key, const std::size_t plaintext_length)
+{
+    const auto value = [&](const std::size_t index) {
+        return cipher::base64::DEFAULT_ASCII_TO_VALUE_ARRAY[static_cast<std::uint8_t>(decode(key, index))];
+    };
+    std::string plaintext(plaintext_length, '\0');
+    for(auto i = 0u; i < plaintext_length; i++) {
+        // Byte i is made of the base64 characters first and first + 1.
+        const auto first = i / 3 * 4 + i % 3;
+        const auto shift = 2 * (i % 3);
+        plaintext[i] = static_cast<char>((value(first) << (2 + shift)) | (value(first + 1) >> (4 - shift)));
+    }
+    return plaintext;
+}
+
+constexpr static const std::size_t MAX_TARGETS = 32;
+
+// A key search over several ciphertexts at once. The key and cursors are shared,
+// every target has its own plaintext. valid_targets has a bit per target that
+// still decodes to acceptable plaintext.
+struct base64_multi_key_bruteforce_state
+{
+    // Every target decodes into its own row of plaintext, so no ciphertext can
+    // be longer than a row holds.
+    constexpr static const std::size_t PLAINTEXT_SIZE = 256;
+    constexpr static const std::size_t MAX_CIPHERTEXT_SIZE = PLAINTEXT_SIZE / 3 * 4;
+
     bool trying_repeat{ false };
+    bool require_all{ false };
+    std::uint32_t valid_targets{ 0 };
     std::size_t plaintext_index{ 0 };
-    std::size_t base64_plaintext_index{ 0 };
     std::size_t ciphertext_index{ 0 };
     std::size_t key_index{ 0 };
     char key[256]{ 0 };
-    char plaintext[256]{ 0 };
-    char base64_plaintext[256]{ 0 };
+    char plaintext[MAX_TARGETS][PLAINTEXT_SIZE]{};
 
-    constexpr std::string_view plaintext_string_view() const
+    constexpr base64_multi_key_bruteforce_state(const std::size_t target_count, const bool require_all)
+        : require_all{ require_all },
+          valid_targets{ static_cast<std::uint32_t>((std::uint64_t{ 1 } << target_count) - 1) }
     {
-        return std::string_view{ plaintext, plaintext_index };
+    }
+
+    constexpr bool is_valid(const std::size_t target) const
+    {
+        return (valid_targets & (std::uint32_t{ 1 } << target)) != 0;
+    }
+
+    constexpr std::string_view plaintext_string_view(const std::size_t target) const
+    {
+        return std::string_view{ plaintext[target], plaintext_index };
     }
 
     constexpr std::string_view key_string_view() const
@@ -141,7 +416,7 @@ struct base64_key_bruteforce_state
 
     constexpr void dealloc()
     {
-        key[key_index--] = 0;
+        key[--key_index] = 0;
     }
 
     template<auto alphabet, auto then>
@@ -155,144 +430,1388 @@ struct base64_key_bruteforce_state
     }
 };
 
+// When a search reaches split.ciphertext_index the state is copied into
+// split.frontier instead of being explored further. Each copy is a complete,
+// independent subtree that can be handed to another thread.
+template<typename StateT>
+struct split_point
+{
+    std::size_t ciphertext_index{ static_cast<std::size_t>(-1) };
+    std::vector<StateT>* frontier{ nullptr };
+};
+
+template<typename StateT>
+inline thread_local split_point<StateT> split{};
+
+template<typename StateT>
+inline thread_local std::vector<StateT>* task_hits{ nullptr };
+
+struct parallel_options
+{
+    std::size_t thread_count{ cipher::parallel::default_thread_count() };
+    // Measured in ciphertext characters past the starting state.
+    std::size_t split_depth{ 2 };
+    // When set, unfinished subtrees are saved here every checkpoint_interval and a
+    // later run with the same path picks up where the previous one stopped.
+    std::filesystem::path checkpoint_path{};
+    std::chrono::seconds checkpoint_interval{ 60 };
+    // Searches run the recursive bruteforce_base64, which is the faster one. This
+    // picks the explicit stack instead, whose depth is not bounded by the
+    // thread's stack, for ciphertexts too long to recurse through.
+    bool iterative{ false };
+    // Everything besides the ciphertext that shapes the search tree, so that
+    // checkpoints and shard workers from a different search are turned away.
+    std::string search_parameters{};
+
+    bool uses_frontier() const
+    {
+        return thread_count > 1 || !checkpoint_path.empty();
+    }
+};
+
+// Identifies the tree a search explores: the ciphertext and the parameters the
+// caller put in options.search_parameters.
+template<auto ciphertext>
+static std::uint64_t search_fingerprint(const parallel_options& options)
+{
+    return cipher::checkpoint::fingerprint(ciphertext) * 0x100000001b3 ^ cipher::checkpoint::fingerprint(options.search_parameters);
+}
+
+// A checkpoint holds the frontier at options.split_depth, so resuming one also
+// needs the same split depth.
+template<auto ciphertext>
+static std::uint64_t checkpoint_fingerprint(const parallel_options& options)
+{
+    return search_fingerprint<ciphertext>(options) * 0x100000001b3 ^ options.split_depth;
+}
+
+struct shard_options
+{
+    // Unix socket the coordinator listens on and workers connect to. Workers on
+    // other hosts can reach it through a forwarded socket.
+    std::filesystem::path socket_path{};
+    // Workers the coordinator forks itself. Others may connect at any time.
+    std::size_t local_workers{ 0 };
+    // Frontier subtrees handed to a worker at once.
+    std::size_t tasks_per_shard{ 16 };
+    // Run as a worker connecting to socket_path instead of as the coordinator.
+    bool worker{ false };
+};
+
+struct beam_options
+{
+    // Most partial states kept at once. The lowest scoring ones are dropped.
+    std::size_t width{ 1u << 16 };
+    // Ciphertext characters decoded each time a state is expanded.
+    std::size_t step{ 4 };
+};
+
+// The subtrees of a split search. Subtrees below next_to_report that are done
+// have already been handed to you_win and are dropped from checkpoints.
+template<typename StateT>
+struct search_frontier
+{
+    // A subtree being searched and the last checkpoint request it answered. A
+    // partial answer holds the hits found until then and the subtrees it had
+    // left, in search order. Otherwise the subtree is saved whole.
+    struct running_task
+    {
+        std::uint64_t request{ 0 };
+        bool partial{ false };
+        std::vector<StateT> hits;
+        std::vector<StateT> pending;
+    };
+
+    std::vector<StateT> tasks;
+    std::vector<std::vector<StateT>> hits;
+    std::vector<bool> done;
+    std::size_t next_to_report{ 0 };
+    std::map<std::size_t, running_task> running;
+
+    void resize(const std::size_t size)
+    {
+        hits.resize(size);
+        done.resize(size, false);
+    }
+
+    // A running subtree that answered a request is saved as done with the hits
+    // so far, followed by the subtrees it had left. Others are saved whole.
+    void save(cipher::checkpoint::writer& w) const
+    {
+        const auto save_hits = [&](const std::vector<StateT>& task_hits) {
+            w.put(true);
+            w.put(static_cast<std::uint64_t>(task_hits.size()));
+            for(const auto& hit : task_hits)
+                hit.save(w);
+        };
+
+        auto size = tasks.size() - next_to_report;
+        for(const auto& [task, r] : running)
+            if (r.partial)
+                size += r.pending.size();
+        w.put(static_cast<std::uint64_t>(size));
+        for(auto i = next_to_report; i < tasks.size(); i++) {
+            const auto r = running.find(i);
+            if (r != running.end() && r->second.partial) {
+                save_hits(r->second.hits);
+                for(const auto& task : r->second.pending) {
+                    w.put(false);
+                    task.save(w);
+                }
+            } else if (done[i]) {
+                save_hits(hits[i]);
+            } else {
+                w.put(false);
+                tasks[i].save(w);
+            }
+        }
+    }
+
+    void load(cipher::checkpoint::reader& r)
+    {
+        const auto size = r.get<std::uint64_t>();
+        tasks.resize(size);
+        resize(size);
+        for(auto i = 0u; i < size; i++) {
+            done[i] = r.get<bool>();
+            if (!done[i]) {
+                tasks[i] = StateT::load(r);
+                continue;
+            }
+            hits[i].resize(r.get<std::uint64_t>());
+            for(auto& hit : hits[i])
+                hit = StateT::load(r);
+        }
+    }
+
+    template<auto you_win>
+    void report_done()
+    {
+        for(; next_to_report < tasks.size() && done[next_to_report]; next_to_report++) {
+            for(const auto& hit : hits[next_to_report])
+                you_win(hit);
+            hits[next_to_report] = {};
+        }
+    }
+};
+
+// Progress of a depth-first search, counted in ciphertext characters that
+// decoded to acceptable plaintext. The total is estimated with Knuth's random probes: a probe
+// follows one random path from root, and the running product of the number of
+// children along it, summed over the levels, is an unbiased estimate of the tree
+// size. Probes run while the search does and their mean sharpens over time.
+// A search resumed from a checkpoint counts only the nodes of this run.
+template<typename StateT>
+struct search_progress
+{
+    std::mutex mutex;
+    bool started{ false };
+    StateT root{};
+    std::chrono::steady_clock::time_point start{};
+    std::chrono::steady_clock::time_point last_sample{};
+    std::atomic<std::uint64_t> nodes{ 0 };
+    double probe_sum{ 0 };
+    std::uint64_t probe_count{ 0 };
+    std::minstd_rand random{ 0x5eed };
+
+    double estimated_nodes()
+    {
+        std::lock_guard lock{ mutex };
+        return probe_count == 0 ? 0. : probe_sum / static_cast<double>(probe_count);
+    }
+};
+
+template<typename StateT>
+inline search_progress<StateT> progress{};
+
+// Nodes are added to progress.nodes in batches, and probes must not count theirs.
+inline thread_local std::uint64_t unreported_nodes{ 0 };
+inline thread_local bool probing{ false };
+
+// Probe nodes are not part of the search, so they stay out of the stats as well.
+inline void count_node(const cipher::stats::counter c, const std::size_t depth)
+{
+    if (!probing)
+        cipher::stats::count(c, depth);
+}
+
+constexpr static const std::uint64_t PROGRESS_BATCH = 1u << 16;
+constexpr static const std::size_t PROBES_PER_SAMPLE = 16;
+constexpr static const std::chrono::seconds PROBE_INTERVAL{ 1 };
+
+template<typename StateT>
+static void start_progress(const StateT& root)
+{
+    auto& p = progress<StateT>;
+    std::lock_guard lock{ p.mutex };
+    p.started = true;
+    p.root = root;
+    p.start = p.last_sample = std::chrono::steady_clock::now();
+    p.nodes = 0;
+    p.probe_sum = 0;
+    p.probe_count = 0;
+}
+
+static std::string format_duration(const double seconds)
+{
+    if (seconds >= 365. * 24 * 3600)
+        return std::to_string(static_cast<std::uint64_t>(seconds / (365. * 24 * 3600))) + "y";
+    auto left = static_cast<std::uint64_t>(seconds);
+    const auto days = left / (24 * 3600);
+    left %= 24 * 3600;
+    std::string text;
+    if (days != 0)
+        text += std::to_string(days) + "d";
+    text += std::to_string(left / 3600) + "h";
+    text += std::to_string(left % 3600 / 60) + "m";
+    text += std::to_string(left % 60) + "s";
+    return text;
+}
+
+// One line for progress_report: nodes searched, nodes per second, the estimated
+// fraction of the tree already explored and the time left at the current rate.
+template<typename StateT>
+static void print_progress(std::FILE* output)
+{
+    auto& p = progress<StateT>;
+    const auto nodes = static_cast<double>(p.nodes.load() + unreported_nodes);
+    const auto estimate = p.estimated_nodes();
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - p.start).count();
+    const auto rate = elapsed > 0 ? nodes / elapsed : 0.;
+    if (estimate == 0 || rate == 0) {
+        std::println(output, "NODES: {:.0f} RATE: {:.0f}/s", nodes, rate);
+        return;
+    }
+    const auto explored = std::min(1., nodes / estimate);
+    std::println(output, "NODES: {:.0f} RATE: {:.0f}/s EXPLORED: {:.6f}% OF ~{:.0f} ETA: {}",
+                 nodes, rate, explored * 100, estimate, format_duration(std::max(0., estimate - nodes) / rate));
+}
+
 template<typename StateT, auto translate_and_alloc>
 constexpr static StateT create_state_with_plaintext(const std::string_view plaintext)
 {
     StateT a;
 
-    for(auto i = 0u; i < plaintext.size() / 3; i++) {
-        const auto plain = plaintext.substr(i*3, 3);
-        char c1 = cipher::base64::DEFAULT_ALPHABET[static_cast<std::uint8_t>((plain[0] & 0b11111100) >> 2)];
-        char c2 = cipher::base64::DEFAULT_ALPHABET[static_cast<std::uint8_t>(((plain[0] & 0b00000011) << 4) | ((plain[1] & 0b11110000) >> 4))];
-        char c3 = cipher::base64::DEFAULT_ALPHABET[static_cast<std::uint8_t>(((plain[1] & 0b00001111) << 2) | ((plain[2] & 0b11000000) >> 6))];
-        char c4 = cipher::base64::DEFAULT_ALPHABET[static_cast<std::uint8_t>(plain[2] & 0b00111111)];
-
-        translate_and_alloc(a, i * 4, c1);
-        translate_and_alloc(a, i * 4 + 1, c2);
-        translate_and_alloc(a, i * 4 + 2, c3);
-        translate_and_alloc(a, i * 4 + 3, c4);
-
-        a.plaintext[i * 3] = plain[0];
-        a.plaintext[i * 3 + 1] = plain[1];
-        a.plaintext[i * 3 + 2] = plain[2];
-
-        a.plaintext_index += 3;
-        a.ciphertext_index += 4;
-    }
-
-    const auto left = plaintext.size() % 3;
-    if (left == 1) {
-        char c1 = cipher::base64::DEFAULT_ALPHABET[static_cast<std::uint8_t>((plaintext[plaintext.size() - 1] & 0b11111100) >> 2)];
-        translate_and_alloc(a, a.ciphertext_index, c1);
-        a.plaintext[a.plaintext_index] = plaintext[plaintext.size() - 1];
-        a.plaintext_index += 1;
-        a.ciphertext_index += 1;
-    } else if (left == 2) {
-        char c1 = cipher::base64::DEFAULT_ALPHABET[static_cast<std::uint8_t>((plaintext[plaintext.size() - 2] & 0b11111100) >> 2)];
-        char c2 = cipher::base64::DEFAULT_ALPHABET[static_cast<std::uint8_t>(((plaintext[plaintext.size() - 2] & 0b00000011) << 4) | ((plaintext[plaintext.size() - 1] & 0b11110000) >> 4))];
-        translate_and_alloc(a, a.ciphertext_index, c1);
-        translate_and_alloc(a, a.ciphertext_index + 1, c2);
-        a.plaintext[a.plaintext_index] = plaintext[plaintext.size() - 2];
-        a.plaintext[a.plaintext_index + 1] = plaintext[plaintext.size() - 1];
-        a.plaintext_index += 2;
-        a.ciphertext_index += 2;
+    std::string base64(cipher::base64::encoded_size(plaintext.size(), false), '\0');
+    cipher::base64::encode<false>(std::span{ base64 }, std::span{ plaintext });
+    // The last character of a partial quantum also holds bits of plaintext
+    // that is not known yet.
+    const auto known = plaintext.size() * 4 / 3;
+
+    for(; a.ciphertext_index < known; a.ciphertext_index++)
+        translate_and_alloc(a, a.ciphertext_index, base64[a.ciphertext_index]);
+
+    // plaintext_index stays at the start of the quantum the search resumes in.
+    // The crib's bytes there only get the high bits of the characters it fixes,
+    // as the decode steps for those characters would have left them; the step
+    // for the next character adds the rest.
+    const auto whole = plaintext.size() / 3 * 3;
+    for(; a.plaintext_index < whole; a.plaintext_index++)
+        a.plaintext[a.plaintext_index] = plaintext[a.plaintext_index];
+    for(auto phase = 0u; whole / 3 * 4 + phase < known; phase++) {
+        const auto step = cipher::base64::decode_char(phase, base64[whole / 3 * 4 + phase]);
+        if (phase != 0)
+            a.plaintext[whole + phase - 1] = static_cast<char>(a.plaintext[whole + phase - 1] + step.finish);
+        a.plaintext[whole + phase] = static_cast<char>(step.start);
+    }
+    if constexpr (requires { a.base64_plaintext; }) {
+        for(auto i = 0u; i < known; i++)
+            a.base64_plaintext[i] = base64[i];
+        a.base64_plaintext_index = whole / 3 * 4;
     }
 
     return a;
 }
 
-template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
-constexpr static void base64_decode_fourth_char(StateT& state, const char plain_base64_char){
-    auto& third_char = state.plaintext[state.plaintext_index + 2];
-    const auto value = cipher::index_in_alphabet<cipher::base64::DEFAULT_ALPHABET>(plain_base64_char);
-    const auto old_value = third_char;
+// The base64 characters a crib pins down when it starts at plaintext byte offset:
+// only those whose six bits all fall inside the crib. Returned as pairs of
+// ciphertext index and base64 character.
+static std::vector<std::pair<std::size_t, char>> crib_base64(const std::string_view crib, const std::size_t offset)
+{
+    std::vector<std::pair<std::size_t, char>> implied;
+    const auto begin = offset * 8;
+    const auto end = (offset + crib.size()) * 8;
+    for(auto index = (begin + 5) / 6; index * 6 + 6 <= end; index++) {
+        std::uint8_t value{ 0 };
+        for(auto bit = index * 6; bit < index * 6 + 6; bit++) {
+            const auto byte = static_cast<std::uint8_t>(crib[bit / 8 - offset]);
+            value = static_cast<std::uint8_t>((value << 1) | ((byte >> (7 - bit % 8)) & 1));
+        }
+        implied.emplace_back(index, cipher::base64::DEFAULT_ALPHABET[value]);
+    }
+    return implied;
+}
+
+// A crib tried at one plaintext offset. key has period characters, with '?' at
+// key positions the crib says nothing about. agreements counts the implied key
+// characters that repeat one implied earlier at the same key position.
+struct crib_placement
+{
+    std::size_t offset;
+    std::size_t period;
+    std::size_t agreements;
+    std::string key;
+};
+
+// Slides a crib over every plaintext offset, on thread_count threads. At each
+// offset key_char(ciphertext_index, base64_char) gives the key character that
+// decodes to the crib there, or 0 when no key character can. The period kept for
+// an offset is the one up to max_period whose implied key characters agree most
+// without contradicting each other. Offsets that fit no period are dropped, the
+// rest are returned best first.
+template<auto key_char>
+static std::vector<crib_placement> drag_crib(const std::string_view crib,
+                                             const std::size_t plaintext_size,
+                                             const std::size_t max_period,
+                                             const std::size_t thread_count)
+{
+    if (crib.empty() || crib.size() > plaintext_size)
+        return {};
+    const auto offsets = plaintext_size - crib.size() + 1;
+    std::vector<std::optional<crib_placement>> placements(offsets);
+
+    cipher::parallel::for_each_task(offsets, thread_count, [&](const std::size_t offset) {
+        std::vector<std::pair<std::size_t, char>> key_chars;
+        for(const auto& [index, base64_char] : crib_base64(crib, offset)) {
+            const auto c = key_char(index, base64_char);
+            if (c == 0)
+                return;
+            key_chars.emplace_back(index, c);
+        }
+
+        for(auto period = 1u; period <= max_period; period++) {
+            std::string key(period, '?');
+            std::size_t agreements{ 0 };
+            bool consistent{ true };
+            for(const auto& [index, c] : key_chars) {
+                auto& slot = key[index % period];
+                if (slot == '?')
+                    slot = c;
+                else if (slot == c)
+                    agreements++;
+                else
+                    consistent = false;
+            }
+            if (consistent && (!placements[offset] || agreements > placements[offset]->agreements))
+                placements[offset] = crib_placement{ offset, period, agreements, std::move(key) };
+        }
+    });
+
+    std::vector<crib_placement> ranked;
+    for(auto& placement : placements)
+        if (placement)
+            ranked.push_back(std::move(*placement));
+    std::stable_sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        return a.agreements > b.agreements;
+    });
+    return ranked;
+}
+
+// Heuristics either judge a single plaintext character, or take the state and
+// the index of the plaintext character that was just completed so they can look
+// at the characters before it.
+template<auto heuristic, typename StateT>
+constexpr static bool accept(const StateT& state, const std::size_t plaintext_index)
+{
+    if constexpr (std::is_invocable_r_v<bool, decltype(heuristic), const StateT&, std::size_t>)
+        return heuristic(state, plaintext_index);
+    else
+        return heuristic(state.plaintext[plaintext_index]);
+}
+
+// Only some states keep the base64 text they decoded.
+template<typename StateT>
+constexpr static void set_base64_char(StateT& state, const std::size_t offset, const char c)
+{
+    if constexpr (requires { state.base64_plaintext; })
+        state.base64_plaintext[state.base64_plaintext_index + offset] = c;
+}
+
+template<typename StateT>
+constexpr static void advance_base64(StateT& state, const int by)
+{
+    if constexpr (requires { state.base64_plaintext; })
+        state.base64_plaintext_index += static_cast<std::size_t>(by);
+}
+
+template<typename StateT, auto get_next_char, auto next>
+constexpr static void next_char(StateT& state)
+{
+    if (state.ciphertext_index >= split<StateT>.ciphertext_index) [[unlikely]] {
+        split<StateT>.frontier->push_back(state);
+        return;
+    }
+
+    get_next_char.template operator()<next>(state);
+}
+
+// Counts a node, and every PROGRESS_BATCH nodes runs a few more probes once
+// PROBE_INTERVAL has passed. Whichever thread gets the lock samples, the others
+// carry on searching.
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic>
+static void count_progress()
+{
+    if (probing || ++unreported_nodes < PROGRESS_BATCH) [[likely]]
+        return;
+
+    auto& p = progress<StateT>;
+    p.nodes += unreported_nodes;
+    unreported_nodes = 0;
+
+    std::unique_lock lock{ p.mutex, std::try_to_lock };
+    const auto now = std::chrono::steady_clock::now();
+    if (!lock.owns_lock() || !p.started || now - p.last_sample < PROBE_INTERVAL)
+        return;
+    for(auto i = 0u; i < PROBES_PER_SAMPLE; i++)
+        p.probe_sum += probe_tree_size<StateT, ciphertext, get_next_char, heuristic>(p.root, p.random);
+    p.probe_count += PROBES_PER_SAMPLE;
+    p.last_sample = std::chrono::steady_clock::now();
+}
+
+// Adds the nodes this thread counted since its last batch, for when a task ends
+// and its count has to be complete.
+template<typename StateT>
+static void flush_progress()
+{
+    progress<StateT>.nodes += unreported_nodes;
+    unreported_nodes = 0;
+}
+
+// A base64 character of the decode, split up so the recursive and the iterative
+// search share it. phase is the position of the character in its quantum.
+// write_base64_char adds its bits to the plaintext and returns the byte it
+// completed, which undo_base64_char puts back.
+template<std::size_t phase, typename StateT>
+constexpr static char write_base64_char(StateT& state, const char plain_base64_char)
+{
+    const auto step = cipher::base64::decode_char(phase, plain_base64_char);
+    set_base64_char(state, phase, plain_base64_char);
+    if constexpr (phase == 0) {
+        state.plaintext[state.plaintext_index] = static_cast<char>(step.start);
+        return 0;
+    } else {
+        auto& finished = state.plaintext[state.plaintext_index + phase - 1];
+        const auto old_value = finished;
+        finished = static_cast<char>(old_value + step.finish);
+        if constexpr (phase != 3)
+            state.plaintext[state.plaintext_index + phase] = static_cast<char>(step.start);
+        return old_value;
+    }
+}
 
-    state.base64_plaintext[state.base64_plaintext_index + 3] = plain_base64_char;
-    third_char = static_cast<char>(old_value + value);
-    if (heuristic(third_char)) {
+template<std::size_t phase, typename StateT>
+constexpr static void undo_base64_char(StateT& state, const char old_value)
+{
+    set_base64_char(state, phase, 0);
+    if constexpr (phase != 0)
+        state.plaintext[state.plaintext_index + phase - 1] = old_value;
+    if constexpr (phase != 3)
+        state.plaintext[state.plaintext_index + phase] = 0;
+}
+
+// Whether the plaintext written so far is still acceptable. The top six bits of
+// a character are not enough for the heuristic, so after the first character of
+// a quantum only printability is checked. It is counted as a heuristic prune.
+template<std::size_t phase, auto heuristic, typename StateT>
+constexpr static bool accept_base64_char(const StateT& state)
+{
+    count_node(cipher::stats::EXPANDED, state.ciphertext_index);
+    if constexpr (phase == 1 || phase == 2) {
+        if ((state.plaintext[state.plaintext_index + phase] & (1 << 7)) != 0) {
+            count_node(cipher::stats::HIGH_BIT_PRUNED, state.ciphertext_index);
+            return false;
+        }
+    }
+
+    bool accepted;
+    if constexpr (phase == 0)
+        accepted = cipher::is_print(state.plaintext[state.plaintext_index]);
+    else
+        accepted = accept<heuristic>(state, state.plaintext_index + phase - 1);
+    if (!accepted)
+        count_node(cipher::stats::HEURISTIC_PRUNED, state.ciphertext_index);
+    return accepted;
+}
+
+// Moves past the character at phase, and past its quantum after the last one.
+template<std::size_t phase, typename StateT>
+constexpr static void enter_next_char(StateT& state)
+{
+    state.ciphertext_index += 1;
+    if constexpr (phase == 3) {
         state.plaintext_index += 3;
-        state.ciphertext_index += 1;
-        state.base64_plaintext_index += 4;
-        bruteforce_base64<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>(state);
+        advance_base64(state, 4);
+    }
+}
+
+template<std::size_t phase, typename StateT>
+constexpr static void leave_next_char(StateT& state)
+{
+    state.ciphertext_index -= 1;
+    if constexpr (phase == 3) {
         state.plaintext_index -= 3;
-        state.ciphertext_index -= 1;
-        state.base64_plaintext_index -= 4;
+        advance_base64(state, -4);
     }
+}
 
-    state.base64_plaintext[state.base64_plaintext_index + 3] = 0;
-    third_char = old_value;
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
+constexpr static void base64_decode_fourth_char(StateT& state, const char plain_base64_char){
+    const auto old_value = write_base64_char<3>(state, plain_base64_char);
+    if (accept_base64_char<3, heuristic>(state)) {
+        count_progress<StateT, ciphertext, get_next_char, heuristic>();
+        enter_next_char<3>(state);
+        bruteforce_base64<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>(state);
+        leave_next_char<3>(state);
+    }
+    undo_base64_char<3>(state, old_value);
 };
 
 template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
 constexpr static void base64_decode_third_char(StateT& state, const char plain_base64_char){
-    auto& second_char = state.plaintext[state.plaintext_index + 1];
-    auto& third_char = state.plaintext[state.plaintext_index + 2];
-    const auto value = cipher::index_in_alphabet<cipher::base64::DEFAULT_ALPHABET>(plain_base64_char);
-    const auto old_value = second_char;
-
-    state.base64_plaintext[state.base64_plaintext_index + 2] = plain_base64_char;
-    second_char = static_cast<char>(old_value + ((value & 0x3c) >> 2));
-    third_char = static_cast<char>((value & 0x03) << 6);
-    if ((third_char & (1 << 7)) == 0 && heuristic(second_char)) {
-        state.ciphertext_index += 1;
-        get_next_char.template operator()<base64_decode_fourth_char<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>>(state);
-        state.ciphertext_index -= 1;
+    const auto old_value = write_base64_char<2>(state, plain_base64_char);
+    if (accept_base64_char<2, heuristic>(state)) {
+        count_progress<StateT, ciphertext, get_next_char, heuristic>();
+        enter_next_char<2>(state);
+        next_char<StateT, get_next_char, base64_decode_fourth_char<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>>(state);
+        leave_next_char<2>(state);
     }
-
-    state.base64_plaintext[state.base64_plaintext_index + 2] = 0;
-    second_char = old_value;
-    third_char = 0;
+    undo_base64_char<2>(state, old_value);
 };
 
 template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
 constexpr static void base64_decode_second_char(StateT& state, const char plain_base64_char){
-    auto& first_char = state.plaintext[state.plaintext_index + 0];
-    auto& second_char = state.plaintext[state.plaintext_index + 1];
-    const auto value = cipher::index_in_alphabet<cipher::base64::DEFAULT_ALPHABET>(plain_base64_char);
-    const auto old_value = first_char;
-
-    state.base64_plaintext[state.base64_plaintext_index + 1] = plain_base64_char;
-    first_char = static_cast<char>(old_value + ((value & 0x30) >> 4));
-    second_char = static_cast<char>((value & 0x0f) << 4);
-    if ((second_char & (1 << 7)) == 0 && heuristic(first_char)) {
-        state.ciphertext_index += 1;
-        get_next_char.template operator()<base64_decode_third_char<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>>(state);
-        state.ciphertext_index -= 1;
+    const auto old_value = write_base64_char<1>(state, plain_base64_char);
+    if (accept_base64_char<1, heuristic>(state)) {
+        count_progress<StateT, ciphertext, get_next_char, heuristic>();
+        enter_next_char<1>(state);
+        next_char<StateT, get_next_char, base64_decode_third_char<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>>(state);
+        leave_next_char<1>(state);
     }
-
-    state.base64_plaintext[state.base64_plaintext_index + 1] = 0;
-    first_char = old_value;
-    second_char = 0;
+    undo_base64_char<1>(state, old_value);
 };
 
 template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
 constexpr static void base64_decode_first_char(StateT& state, const char plain_base64_char){
-    auto& first_char = state.plaintext[state.plaintext_index + 0];
-    const auto value = cipher::index_in_alphabet<cipher::base64::DEFAULT_ALPHABET>(plain_base64_char);
-
-    state.base64_plaintext[state.base64_plaintext_index] = plain_base64_char;
-    first_char = static_cast<char>(value << 2);
-    if (cipher::is_print(first_char)) {
-        state.ciphertext_index += 1;
-        get_next_char.template operator()<base64_decode_second_char<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>>(state);
-        state.ciphertext_index -= 1;
+    const auto old_value = write_base64_char<0>(state, plain_base64_char);
+    if (accept_base64_char<0, heuristic>(state)) {
+        count_progress<StateT, ciphertext, get_next_char, heuristic>();
+        enter_next_char<0>(state);
+        next_char<StateT, get_next_char, base64_decode_second_char<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>>(state);
+        leave_next_char<0>(state);
     }
-
-    state.base64_plaintext[state.base64_plaintext_index] = 0;
-    first_char = 0;
+    undo_base64_char<0>(state, old_value);
 };
 
 template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
 constexpr static void bruteforce_base64(StateT& state)
 {
     progress_report(state);
+    cipher::stats::tick();
 
     if (state.ciphertext_index >= ciphertext.size()) [[unlikely]] {
         you_win(state);
         return;
     }
 
-    get_next_char.template operator()<base64_decode_first_char<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>>(state);
+    next_char<StateT, get_next_char, base64_decode_first_char<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>>(state);
+}
+
+// Continues a search from a state captured at any ciphertext character, picking
+// the decode step from the position inside the current base64 quantum.
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
+constexpr static void resume_base64(StateT& state)
+{
+    switch(state.ciphertext_index % 4) {
+        case 0:
+            bruteforce_base64<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>(state);
+            return;
+        case 1:
+            get_next_char.template operator()<base64_decode_second_char<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>>(state);
+            return;
+        case 2:
+            get_next_char.template operator()<base64_decode_third_char<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>>(state);
+            return;
+        default:
+            get_next_char.template operator()<base64_decode_fourth_char<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>>(state);
+            return;
+    }
+}
+
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic>
+static double probe_tree_size(const StateT& root, std::minstd_rand& random)
+{
+    constexpr static auto to_frontier = [](const StateT& state) {
+        split<StateT>.frontier->push_back(state);
+    };
+    constexpr static auto no_report = [](const StateT&) {};
+
+    const auto outer_split = split<StateT>;
+    const auto outer_probing = probing;
+    probing = true;
+
+    std::vector<StateT> children;
+    auto state = root;
+    double width = 1;
+    double total = 1;
+    while(state.ciphertext_index < ciphertext.size()) {
+        children.clear();
+        split<StateT> = { state.ciphertext_index + std::size_t{ 1 }, &children };
+        resume_base64<StateT, ciphertext, get_next_char, heuristic, to_frontier, no_report>(state);
+        if (children.empty())
+            break;
+        width *= static_cast<double>(children.size());
+        total += width;
+        state = children[random() % children.size()];
+    }
+
+    split<StateT> = outer_split;
+    probing = outer_probing;
+    return total;
+}
+
+// The explicit stack of an iterative search, one frame per ciphertext character
+// below the starting state. A frame is the range of candidates that survived the
+// next character, with a cursor to the one being searched. A candidate is only
+// what get_next_char chose, StateT::choice, and the base64 character: the search
+// keeps a single state and redoes and undoes the steps along its path.
+template<typename StateT>
+struct search_stack
+{
+    struct candidate
+    {
+        typename StateT::choice choice;
+        char base64_char;
+    };
+
+    struct frame
+    {
+        std::size_t begin;
+        std::size_t end;
+        std::size_t next;
+        // The plaintext byte the candidate before next completed.
+        char old_value;
+    };
+
+    // get_next_char offers at most one candidate per base64 character, so no
+    // frame holds more.
+    constexpr static const std::size_t MAX_FAN_OUT = 64;
+
+    std::vector<candidate> candidates;
+    std::vector<frame> frames;
+
+    // Room for a search depth characters deep, so it never grows while running.
+    void reserve(const std::size_t depth)
+    {
+        frames.reserve(depth + 1);
+        candidates.reserve((depth + 1) * MAX_FAN_OUT);
+    }
+};
+
+// One stack per thread, kept across the tasks it searches.
+template<typename StateT>
+inline thread_local search_stack<StateT> thread_stack{};
+
+template<typename StateT>
+inline thread_local search_stack<StateT>* collecting{ nullptr };
+
+// Called every CHECKPOINT_POLL nodes of an iterative search with its state and
+// stack, so that a checkpoint can save what a running search has left.
+template<typename StateT>
+inline thread_local const std::function<void(const StateT&, const search_stack<StateT>&)>* checkpoint_poll{ nullptr };
+
+constexpr static const std::uint64_t CHECKPOINT_POLL = 1u << 16;
+
+// Takes the place of a decode step while a frame is filled: keeps the candidate
+// if it survives, without searching below it.
+template<typename StateT, auto heuristic, std::size_t phase>
+constexpr static void collect_candidate(StateT& state, const char plain_base64_char)
+{
+    const auto old_value = write_base64_char<phase>(state, plain_base64_char);
+    if (accept_base64_char<phase, heuristic>(state))
+        collecting<StateT>->candidates.push_back({ state.current_choice(), plain_base64_char });
+    undo_base64_char<phase>(state, old_value);
+}
+
+// Calls f.template operator()<phase>() for a phase only known at run time.
+template<typename F>
+constexpr static void with_phase(const std::size_t phase, const F& f)
+{
+    switch(phase) {
+        case 0:
+            f.template operator()<0>();
+            return;
+        case 1:
+            f.template operator()<1>();
+            return;
+        case 2:
+            f.template operator()<2>();
+            return;
+        default:
+            f.template operator()<3>();
+            return;
+    }
+}
+
+// Visits the node the state is at like bruteforce_base64 and next_char do, and
+// pushes a frame with its candidates. Returns false when there is nothing to
+// search below it. Like resume_base64, a starting state inside a quantum is not
+// split.
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
+static bool push_frame(StateT& state, search_stack<StateT>& stack, const bool start)
+{
+    const auto phase = state.ciphertext_index % 4;
+    if (phase == 0) {
+        progress_report(state);
+        cipher::stats::tick();
+        if (state.ciphertext_index >= ciphertext.size()) [[unlikely]] {
+            you_win(state);
+            return false;
+        }
+    } else if (state.ciphertext_index >= ciphertext.size()) [[unlikely]] {
+        return false;
+    }
+    if ((!start || phase == 0) && state.ciphertext_index >= split<StateT>.ciphertext_index) [[unlikely]] {
+        split<StateT>.frontier->push_back(state);
+        return false;
+    }
+
+    const auto begin = stack.candidates.size();
+    with_phase(phase, [&]<std::size_t p>() {
+        get_next_char.template operator()<collect_candidate<StateT, heuristic, p>>(state);
+    });
+    if (stack.candidates.size() == begin)
+        return false;
+    stack.frames.push_back({ begin, stack.candidates.size(), begin, 0 });
+    return true;
+}
+
+// Undoes the candidate the frame searched last.
+template<typename StateT>
+static void leave_candidate(StateT& state, const typename search_stack<StateT>::frame& frame)
+{
+    with_phase((state.ciphertext_index - 1u) % 4, [&]<std::size_t p>() {
+        leave_next_char<p>(state);
+        undo_base64_char<p>(state, frame.old_value);
+    });
+}
+
+// What an iterative search at the top of its loop has left, as subtrees in the
+// order it would search them: the candidates not tried yet, deepest frame first.
+template<typename StateT>
+static std::vector<StateT> pending_subtrees(StateT state, const search_stack<StateT>& stack)
+{
+    std::vector<StateT> pending;
+    for(auto f = stack.frames.size(); f-- > 0;) {
+        const auto& frame = stack.frames[f];
+        for(auto i = frame.next; i < frame.end; i++) {
+            const auto& candidate = stack.candidates[i];
+            auto& child = pending.emplace_back(state);
+            child.restore(candidate.choice);
+            with_phase(child.ciphertext_index % 4, [&]<std::size_t p>() {
+                write_base64_char<p>(child, candidate.base64_char);
+                enter_next_char<p>(child);
+            });
+        }
+        if (f != 0)
+            leave_candidate(state, stack.frames[f - 1]);
+    }
+    return pending;
+}
+
+// Same search as bruteforce_base64, in the same order, on an explicit stack
+// instead of one level of recursion per ciphertext character. The state is left
+// as it was.
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
+static void iterative_bruteforce_base64(StateT& state, search_stack<StateT>& stack)
+{
+    const auto start_choice = state.current_choice();
+    const auto outer_collecting = collecting<StateT>;
+    collecting<StateT> = &stack;
+    const auto poll = checkpoint_poll<StateT>;
+    std::uint64_t since_poll{ 0 };
+
+    push_frame<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, stack, true);
+    while(!stack.frames.empty()) {
+        if (poll != nullptr && ++since_poll == CHECKPOINT_POLL) [[unlikely]] {
+            (*poll)(state, stack);
+            since_poll = 0;
+        }
+        auto& frame = stack.frames.back();
+        if (frame.next == frame.end) {
+            stack.candidates.resize(frame.begin);
+            stack.frames.pop_back();
+            if (!stack.frames.empty())
+                leave_candidate(state, stack.frames.back());
+            continue;
+        }
+
+        const auto candidate = stack.candidates[frame.next++];
+        state.restore(candidate.choice);
+        with_phase(state.ciphertext_index % 4, [&]<std::size_t p>() {
+            frame.old_value = write_base64_char<p>(state, candidate.base64_char);
+            count_progress<StateT, ciphertext, get_next_char, heuristic>();
+            enter_next_char<p>(state);
+        });
+        // Pushing a frame may move the frames, so the parent is looked up again.
+        if (!push_frame<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, stack, false))
+            leave_candidate(state, stack.frames.back());
+    }
+
+    collecting<StateT> = outer_collecting;
+    state.restore(start_choice);
+}
+
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
+static void iterative_bruteforce_base64(const StateT& initial_state)
+{
+    auto state = initial_state;
+    auto& stack = thread_stack<StateT>;
+    assert(stack.frames.empty() && stack.candidates.empty());
+    stack.reserve(ciphertext.size() - std::min<std::size_t>(state.ciphertext_index, ciphertext.size()));
+    iterative_bruteforce_base64<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>(state, stack);
+}
+
+// Searches below a state on the calling thread with bruteforce_base64, or on an
+// explicit stack when options.iterative asks for it.
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
+static void search_base64(const StateT& initial_state, const parallel_options& options)
+{
+    if (options.iterative) {
+        iterative_bruteforce_base64<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>(initial_state);
+        return;
+    }
+    auto state = initial_state;
+    resume_base64<StateT, ciphertext, get_next_char, heuristic, you_win, progress_report>(state);
+}
+
+// Explores the tree down to options.split_depth on the calling thread, then runs
+// every subtree below it on a work-stealing pool. Hits are buffered per subtree
+// and handed to you_win in the same order a single-threaded search reports them,
+// regardless of thread count. With a checkpoint path a checkpoint falls due
+// every checkpoint_interval. Subtrees being searched answer it with what they
+// have left the next time they poll, and the last one to answer writes it, so a
+// long subtree does not hold back its progress. Only the iterative search polls;
+// the recursive one saves a running subtree whole.
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
+static void parallel_bruteforce_base64(const StateT& initial_state, const parallel_options& options)
+{
+    constexpr static auto to_frontier = [](const StateT& state) {
+        split<StateT>.frontier->push_back(state);
+    };
+    constexpr static auto to_task_hits = [](const StateT& state) {
+        task_hits<StateT>->push_back(state);
+    };
+
+    const auto fingerprint = checkpoint_fingerprint<ciphertext>(options);
+    const auto& checkpoint_path = options.checkpoint_path;
+
+    start_progress(initial_state);
+    search_frontier<StateT> frontier;
+    const auto resumed = !checkpoint_path.empty() && cipher::checkpoint::load(checkpoint_path, fingerprint, [&](auto& r) {
+        frontier.load(r);
+    });
+    if (!resumed) {
+        auto state = initial_state;
+        split<StateT> = { initial_state.ciphertext_index + options.split_depth, &frontier.tasks };
+        resume_base64<StateT, ciphertext, get_next_char, heuristic, to_frontier, progress_report>(state);
+        split<StateT> = {};
+        frontier.resize(frontier.tasks.size());
+    }
+
+    std::vector<std::size_t> pending;
+    for(auto i = 0u; i < frontier.tasks.size(); i++)
+        if (!frontier.done[i])
+            pending.push_back(i);
+
+    std::mutex report_mutex;
+    auto last_checkpoint = std::chrono::steady_clock::now();
+    // Checkpoints asked of the running subtrees, and the last one written.
+    std::uint64_t requested{ 0 };
+    std::uint64_t written{ 0 };
+    frontier.template report_done<you_win>();
+
+    const auto request_checkpoint = [&] {
+        if (!checkpoint_path.empty() && requested == written && std::chrono::steady_clock::now() - last_checkpoint >= options.checkpoint_interval)
+            requested++;
+    };
+    const auto write_checkpoint = [&] {
+        if (requested == written)
+            return;
+        for(const auto& [task, r] : frontier.running)
+            if (r.request != requested && options.iterative)
+                return;
+        // A failed checkpoint is retried at the next interval.
+        cipher::checkpoint::try_save(checkpoint_path, fingerprint, [&](auto& w) {
+            frontier.save(w);
+        });
+        last_checkpoint = std::chrono::steady_clock::now();
+        written = requested;
+    };
+
+    cipher::parallel::for_each_task(pending.size(), options.thread_count, [&](const std::size_t pending_index) {
+        const auto task = pending[pending_index];
+        std::vector<StateT> task_result;
+        const std::function<void(const StateT&, const search_stack<StateT>&)> poll = [&](const StateT& state, const search_stack<StateT>& stack) {
+            std::lock_guard lock{ report_mutex };
+            request_checkpoint();
+            auto& r = frontier.running[task];
+            if (r.request == requested)
+                return;
+            r = { requested, true, task_result, pending_subtrees(state, stack) };
+            write_checkpoint();
+        };
+        // Nothing is lost by saving a subtree that just started whole.
+        {
+            std::lock_guard lock{ report_mutex };
+            frontier.running[task] = { requested, false, {}, {} };
+        }
+        task_hits<StateT> = &task_result;
+        checkpoint_poll<StateT> = checkpoint_path.empty() ? nullptr : &poll;
+        search_base64<StateT, ciphertext, get_next_char, heuristic, to_task_hits, progress_report>(frontier.tasks[task], options);
+        checkpoint_poll<StateT> = nullptr;
+        task_hits<StateT> = nullptr;
+        flush_progress<StateT>();
+
+        std::lock_guard lock{ report_mutex };
+        frontier.running.erase(task);
+        frontier.hits[task] = std::move(task_result);
+        frontier.done[task] = true;
+        frontier.template report_done<you_win>();
+        request_checkpoint();
+        write_checkpoint();
+    });
+
+    if (!checkpoint_path.empty())
+        std::filesystem::remove(checkpoint_path);
+}
+
+// Runs shards handed out by a coordinator on options.thread_count threads and
+// sends back the hits of every task. Returns when the coordinator has no work
+// left or goes away.
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto progress_report>
+static void shard_worker_bruteforce_base64(const parallel_options& options, const shard_options& shards)
+{
+    using cipher::shard::message_type;
+    constexpr static auto to_task_hits = [](const StateT& state) {
+        task_hits<StateT>->push_back(state);
+    };
+
+    const auto fd = cipher::shard::connect_unix(shards.socket_path);
+    const auto hello = cipher::shard::encode([&](auto& w) {
+        w.put(search_fingerprint<ciphertext>(options));
+    });
+    auto connected = cipher::shard::send_message(fd, message_type::hello, hello);
+
+    std::vector<StateT> tasks;
+    std::vector<std::vector<StateT>> hits;
+    while(connected) {
+        auto m = cipher::shard::receive_message(fd);
+        if (!m || m->type != message_type::shard)
+            break;
+
+        std::uint64_t first_task{ 0 };
+        cipher::shard::decode(m->payload, [&](auto& r) {
+            first_task = r.template get<std::uint64_t>();
+            tasks.resize(r.template get<std::uint64_t>());
+            for(auto& task : tasks)
+                task = StateT::load(r);
+        });
+
+        const auto nodes_before = progress<StateT>.nodes.load();
+        hits.assign(tasks.size(), {});
+        cipher::parallel::for_each_task(tasks.size(), options.thread_count, [&](const std::size_t task) {
+            task_hits<StateT> = &hits[task];
+            search_base64<StateT, ciphertext, get_next_char, heuristic, to_task_hits, progress_report>(tasks[task], options);
+            task_hits<StateT> = nullptr;
+            flush_progress<StateT>();
+        });
+
+        for(auto task = 0u; connected && task < tasks.size(); task++)
+            for(auto hit = 0u; connected && hit < hits[task].size(); hit++)
+                connected = cipher::shard::send_message(fd, message_type::hit, cipher::shard::encode([&](auto& w) {
+                    w.put(static_cast<std::uint64_t>(first_task + task));
+                    hits[task][hit].save(w);
+                }));
+        connected = connected && cipher::shard::send_message(fd, message_type::done, cipher::shard::encode([&](auto& w) {
+            w.put(static_cast<std::uint64_t>(progress<StateT>.nodes.load() - nodes_before));
+        }));
+    }
+    ::close(fd);
+}
+
+// Splits the tree like parallel_bruteforce_base64 and hands contiguous ranges of
+// the frontier to worker processes. From an empty key the frontier at split
+// depth 1 or 2 is ordered by the first one or two key characters, so a shard is
+// a key prefix range. A shard whose worker disconnects before finishing goes
+// back to the queue for the next worker. Hits are reported in the same order as
+// a single-threaded search. Checkpoints save the shards out with workers whole.
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report>
+static void sharded_bruteforce_base64(const StateT& initial_state, const parallel_options& options, const shard_options& shards)
+{
+    using cipher::shard::message_type;
+    using shard_range = std::pair<std::size_t, std::size_t>;
+    constexpr static auto to_frontier = [](const StateT& state) {
+        split<StateT>.frontier->push_back(state);
+    };
+
+    const auto fingerprint = checkpoint_fingerprint<ciphertext>(options);
+    const auto& checkpoint_path = options.checkpoint_path;
+
+    search_frontier<StateT> frontier;
+    const auto resumed = !checkpoint_path.empty() && cipher::checkpoint::load(checkpoint_path, fingerprint, [&](auto& r) {
+        frontier.load(r);
+    });
+    if (!resumed) {
+        auto state = initial_state;
+        split<StateT> = { initial_state.ciphertext_index + options.split_depth, &frontier.tasks };
+        resume_base64<StateT, ciphertext, get_next_char, heuristic, to_frontier, progress_report>(state);
+        split<StateT> = {};
+        frontier.resize(frontier.tasks.size());
+    }
+    frontier.template report_done<you_win>();
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<shard_range> queue;
+    for(auto task = 0u; task < frontier.tasks.size();) {
+        if (frontier.done[task]) {
+            task++;
+            continue;
+        }
+        auto end = task;
+        while(end < frontier.tasks.size() && !frontier.done[end] && end - task < std::max<std::size_t>(shards.tasks_per_shard, 1u))
+            end++;
+        queue.emplace_back(task, end);
+        task = end;
+    }
+    auto outstanding = queue.size();
+    const auto total = outstanding;
+    std::size_t connections{ 0 };
+    std::uint64_t nodes{ 0 };
+    auto last_checkpoint = std::chrono::steady_clock::now();
+
+    const auto serve = [&](const int fd) {
+        auto hello = cipher::shard::receive_message(fd);
+        std::uint64_t worker_fingerprint{ 0 };
+        if (hello && hello->type == message_type::hello)
+            cipher::shard::decode(hello->payload, [&](auto& r) { worker_fingerprint = r.template get<std::uint64_t>(); });
+        if (worker_fingerprint != search_fingerprint<ciphertext>(options)) {
+            std::println(stderr, "rejected a worker running a different search");
+            return;
+        }
+
+        for(;;) {
+            shard_range range;
+            {
+                std::unique_lock lock{ mutex };
+                changed.wait(lock, [&] { return !queue.empty() || outstanding == 0; });
+                if (queue.empty())
+                    break;
+                range = queue.front();
+                queue.pop_front();
+            }
+
+            const auto [first, last] = range;
+            const auto payload = cipher::shard::encode([&](auto& w) {
+                w.put(static_cast<std::uint64_t>(first));
+                w.put(static_cast<std::uint64_t>(last - first));
+                for(auto task = first; task < last; task++)
+                    frontier.tasks[task].save(w);
+            });
+
+            std::vector<std::vector<StateT>> hits(last - first);
+            std::optional<std::uint64_t> shard_nodes;
+            try {
+                if (cipher::shard::send_message(fd, message_type::shard, payload)) {
+                    while(auto m = cipher::shard::receive_message(fd)) {
+                        if (m->type == message_type::hit) {
+                            cipher::shard::decode(m->payload, [&](auto& r) {
+                                const auto task = r.template get<std::uint64_t>();
+                                if (task < first || task >= last)
+                                    throw std::runtime_error("worker reported a task outside its shard");
+                                hits[task - first].push_back(StateT::load(r));
+                            });
+                        } else if (m->type == message_type::done) {
+                            cipher::shard::decode(m->payload, [&](auto& r) { shard_nodes = r.template get<std::uint64_t>(); });
+                            break;
+                        }
+                    }
+                }
+            } catch(const std::exception& e) {
+                std::println(stderr, "bad message from worker: {}", e.what());
+                shard_nodes.reset();
+            }
+
+            std::lock_guard lock{ mutex };
+            if (!shard_nodes) {
+                std::println(stderr, "worker lost, shard {}-{} is queued again", first, last);
+                queue.push_front(range);
+                changed.notify_all();
+                return;
+            }
+
+            for(auto task = first; task < last; task++) {
+                frontier.hits[task] = std::move(hits[task - first]);
+                frontier.done[task] = true;
+            }
+            frontier.template report_done<you_win>();
+            outstanding--;
+            nodes += *shard_nodes;
+            std::println(stderr, "SHARDS: {}/{} NODES: {}", total - outstanding, total, nodes);
+
+            const auto now = std::chrono::steady_clock::now();
+            if (!checkpoint_path.empty() && now - last_checkpoint >= options.checkpoint_interval) {
+                cipher::checkpoint::try_save(checkpoint_path, fingerprint, [&](auto& w) {
+                    frontier.save(w);
+                });
+                last_checkpoint = now;
+            }
+            changed.notify_all();
+        }
+        cipher::shard::send_message(fd, message_type::quit);
+    };
+
+    const auto listener = cipher::shard::listen_unix(shards.socket_path);
+
+    // Forked before any thread exists, so the children start from a clean state.
+    std::vector<pid_t> workers;
+    std::fflush(nullptr);
+    for(auto i = 0u; i < shards.local_workers; i++) {
+        const auto pid = ::fork();
+        if (pid == 0) {
+            ::close(listener);
+            shard_worker_bruteforce_base64<StateT, ciphertext, get_next_char, heuristic, progress_report>(options, shards);
+            std::fflush(nullptr);
+            ::_exit(0);
+        }
+        if (pid > 0)
+            workers.push_back(pid);
+    }
+
+    std::vector<int> fds;
+    std::vector<std::jthread> servers;
+    std::size_t live_workers = workers.size();
+    for(;;) {
+        {
+            std::lock_guard lock{ mutex };
+            if (outstanding == 0)
+                break;
+            if (!workers.empty() && live_workers == 0 && connections == 0) {
+                std::println(stderr, "every worker has exited with {} shards left", outstanding);
+                break;
+            }
+        }
+
+        pollfd waiting{ listener, POLLIN, 0 };
+        if (::poll(&waiting, 1, 200) > 0) {
+            const auto fd = ::accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                std::lock_guard lock{ mutex };
+                connections++;
+                fds.push_back(fd);
+                servers.emplace_back([&, fd] {
+                    try {
+                        serve(fd);
+                    } catch(const std::exception& e) {
+                        std::println(stderr, "dropped a worker: {}", e.what());
+                    }
+                    ::shutdown(fd, SHUT_RDWR);
+                    std::lock_guard lock{ mutex };
+                    connections--;
+                    changed.notify_all();
+                });
+            }
+        }
+        for(auto& pid : workers)
+            if (pid > 0 && ::waitpid(pid, nullptr, WNOHANG) == pid) {
+                pid = -1;
+                live_workers--;
+            }
+    }
+
+    {
+        std::lock_guard lock{ mutex };
+        for(const auto fd : fds)
+            ::shutdown(fd, SHUT_RDWR);
+        changed.notify_all();
+    }
+    servers.clear();
+    for(const auto fd : fds)
+        ::close(fd);
+    ::close(listener);
+    ::unlink(shards.socket_path.c_str());
+    for(const auto pid : workers)
+        if (pid > 0)
+            ::waitpid(pid, nullptr, 0);
+
+    if (outstanding != 0) {
+        if (!checkpoint_path.empty())
+            cipher::checkpoint::save(checkpoint_path, fingerprint, [&](auto& w) {
+                frontier.save(w);
+            });
+        throw std::runtime_error("sharded search stopped before it was complete");
+    }
+    if (!checkpoint_path.empty())
+        std::filesystem::remove(checkpoint_path);
+}
+
+// Best-first search instead of depth-first: the highest scoring partial state is
+// expanded next, using the same get_next_char and decode steps as the DFS. States
+// are ranked by score(state), higher is better. At most options.width states are
+// kept, so memory is capped but the lowest scoring branches are lost for good.
+template<typename StateT, auto ciphertext, auto get_next_char, auto heuristic, auto you_win, auto progress_report, auto score>
+static void beam_bruteforce_base64(const StateT& initial_state, const beam_options& options)
+{
+    constexpr static auto to_frontier = [](const StateT& state) {
+        split<StateT>.frontier->push_back(state);
+    };
+
+    std::multimap<float, StateT, std::greater<>> beam;
+    std::vector<StateT> children;
+    beam.emplace(score(initial_state), initial_state);
+
+    while(!beam.empty()) {
+        auto node = beam.extract(beam.begin());
+        auto& state = node.mapped();
+        if (state.ciphertext_index >= ciphertext.size()) {
+            you_win(state);
+            continue;
+        }
+
+        children.clear();
+        split<StateT> = { state.ciphertext_index + std::max<std::size_t>(options.step, 1u), &children };
+        resume_base64<StateT, ciphertext, get_next_char, heuristic, to_frontier, progress_report>(state);
+        split<StateT> = {};
+
+        for(auto& child : children) {
+            beam.emplace(score(child), std::move(child));
+            if (beam.size() > options.width)
+                beam.erase(std::prev(beam.end()));
+        }
+    }
+}
+
+// What a heuristic sees of one target in a multi-target search. It has the same
+// plaintext member as the single-target states, so the same heuristics work.
+struct target_view
+{
+    const char* plaintext;
+};
+
+template<auto ciphertexts>
+constexpr static std::size_t longest_ciphertext()
+{
+    std::size_t longest{ 0 };
+    for(const auto& ciphertext : ciphertexts)
+        longest = std::max<std::size_t>(longest, ciphertext.size());
+    return longest;
+}
+
+// Whether any target that still decodes has characters past ciphertext_index.
+template<auto ciphertexts, typename StateT>
+constexpr static bool has_ciphertext_left(const StateT& state)
+{
+    for(auto target = 0u; target < ciphertexts.size(); target++)
+        if (state.is_valid(target) && state.ciphertext_index < ciphertexts[target].size())
+            return true;
+    return false;
+}
+
+// Decodes the character at state.ciphertext_index of every target with the key
+// chosen by get_next_char. decode(state, target) returns the plain base64
+// character of that target. A target that fails the checks prunes the branch when
+// state.require_all is set and is otherwise only dropped from valid_targets.
+template<typename StateT, auto ciphertexts, auto get_next_char, auto decode, auto heuristic, auto you_win, auto progress_report>
+constexpr static void base64_multi_decode_char(StateT& state)
+{
+    const auto phase = state.ciphertext_index % 4;
+    const auto valid_targets = state.valid_targets;
+    char saved[MAX_TARGETS][3];
+
+    count_node(cipher::stats::EXPANDED, state.ciphertext_index);
+    auto valid = valid_targets;
+    auto high_bit_pruned = false;
+    std::size_t decoded{ 0 };
+    for(; decoded < ciphertexts.size(); decoded++) {
+        const auto target = decoded;
+        auto* plain = state.plaintext[target] + state.plaintext_index;
+        saved[target][0] = plain[0];
+        saved[target][1] = plain[1];
+        saved[target][2] = plain[2];
+        if (!state.is_valid(target) || state.ciphertext_index >= ciphertexts[target].size())
+            continue;
+
+        const auto step = cipher::base64::decode_char(phase, decode(state, target));
+        if (phase != 0)
+            plain[phase - 1] = static_cast<char>(plain[phase - 1] + step.finish);
+        if (phase != 3)
+            plain[phase] = static_cast<char>(step.start);
+        bool ok;
+        bool high_bit{ false };
+        switch(phase) {
+            case 0:
+                ok = cipher::is_print(plain[0]);
+                break;
+            case 1:
+            case 2:
+                high_bit = (plain[phase] & (1 << 7)) != 0;
+                ok = !high_bit && accept<heuristic>(target_view{ state.plaintext[target] }, state.plaintext_index + phase - 1);
+                break;
+            default:
+                ok = accept<heuristic>(target_view{ state.plaintext[target] }, state.plaintext_index + 2);
+                break;
+        }
+
+        if (!ok) {
+            high_bit_pruned = high_bit;
+            valid &= ~(std::uint32_t{ 1 } << target);
+            if (state.require_all) {
+                decoded++;
+                break;
+            }
+        }
+    }
+
+    if (valid != 0 && (!state.require_all || valid == valid_targets)) {
+        state.valid_targets = valid;
+        state.ciphertext_index += 1;
+        if (phase == 3) {
+            state.plaintext_index += 3;
+            bruteforce_base64_multi<StateT, ciphertexts, get_next_char, decode, heuristic, you_win, progress_report>(state);
+            state.plaintext_index -= 3;
+        } else {
+            get_next_char.template operator()<base64_multi_decode_char<StateT, ciphertexts, get_next_char, decode, heuristic, you_win, progress_report>>(state);
+        }
+        state.ciphertext_index -= 1;
+        state.valid_targets = valid_targets;
+    } else {
+        // Counted by the reason the last failing target was dropped.
+        count_node(high_bit_pruned ? cipher::stats::HIGH_BIT_PRUNED : cipher::stats::HEURISTIC_PRUNED, state.ciphertext_index);
+    }
+
+    for(auto target = 0u; target < decoded; target++) {
+        auto* plain = state.plaintext[target] + state.plaintext_index;
+        plain[0] = saved[target][0];
+        plain[1] = saved[target][1];
+        plain[2] = saved[target][2];
+    }
+}
+
+// Walks the key tree once for a whole batch of ciphertexts instead of once per
+// ciphertext. Each key prefix is checked against every target before it is
+// extended, and the search ends once every target still decoding is used up.
+template<typename StateT, auto ciphertexts, auto get_next_char, auto decode, auto heuristic, auto you_win, auto progress_report>
+constexpr static void bruteforce_base64_multi(StateT& state)
+{
+    progress_report(state);
+    cipher::stats::tick();
+
+    if (!has_ciphertext_left<ciphertexts>(state)) [[unlikely]] {
+        you_win(state);
+        return;
+    }
+
+    get_next_char.template operator()<base64_multi_decode_char<StateT, ciphertexts, get_next_char, decode, heuristic, you_win, progress_report>>(state);
 }
 
 }
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace cipher::checkpoint
+{
+
+constexpr static const std::string_view MAGIC = "CIPHERCK";
+constexpr static const std::uint32_t VERSION = 3;
+
+template<typename T>
+constexpr static std::uint64_t fingerprint(const T& data)
+{
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for(const auto c : data) {
+        hash ^= static_cast<std::uint8_t>(c);
+        hash *= 0x100000001b3;
+    }
+    return hash ^ data.size();
+}
+
+// A checkpoint that is there but cannot be resumed from: cut short, damaged, or
+// written by another search.
+struct invalid_checkpoint : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+struct writer
+{
+    std::FILE* file;
+
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    void put(const T& value)
+    {
+        if (std::fwrite(&value, sizeof(T), 1, file) != 1)
+            throw std::runtime_error("failed to write checkpoint");
+    }
+
+    void put_bytes(const char* bytes, const std::size_t length)
+    {
+        put(static_cast<std::uint32_t>(length));
+        if (length != 0 && std::fwrite(bytes, 1, length, file) != length)
+            throw std::runtime_error("failed to write checkpoint");
+    }
+};
+
+struct reader
+{
+    std::FILE* file;
+
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    T get()
+    {
+        T value;
+        if (std::fread(&value, sizeof(T), 1, file) != 1)
+            throw invalid_checkpoint("truncated checkpoint");
+        return value;
+    }
+
+    std::size_t get_bytes(char* bytes, const std::size_t capacity)
+    {
+        const auto length = get<std::uint32_t>();
+        if (length > capacity)
+            throw invalid_checkpoint("corrupt checkpoint");
+        if (length != 0 && std::fread(bytes, 1, length, file) != length)
+            throw invalid_checkpoint("truncated checkpoint");
+        return length;
+    }
+};
+
+// Flushes what was written to path to disk, or the entries of path when it is a
+// directory.
+static void sync(const std::filesystem::path& path, const int flags)
+{
+    const auto fd = ::open(path.c_str(), flags);
+    if (fd < 0 || ::fsync(fd) != 0) {
+        const auto error = errno;
+        if (fd >= 0)
+            ::close(fd);
+        throw std::runtime_error("failed to sync " + path.string() + ": " + std::strerror(error));
+    }
+    ::close(fd);
+}
+
+// Writes to a temporary file next to path and renames it over path once it is on
+// disk, so a crash while checkpointing leaves the previous checkpoint intact. The
+// directory is synced too, or the rename itself could be lost.
+template<typename F>
+static void save(const std::filesystem::path& path, const std::uint64_t fingerprint, const F& write_body)
+{
+    auto temporary = path;
+    temporary += ".tmp";
+
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr)
+        throw std::runtime_error("failed to open checkpoint " + temporary.string());
+
+    try {
+        writer w{ file };
+        w.put_bytes(MAGIC.data(), MAGIC.size());
+        w.put(VERSION);
+        w.put(fingerprint);
+        write_body(w);
+    } catch(...) {
+        std::fclose(file);
+        throw;
+    }
+
+    if (std::fflush(file) != 0 || ::fsync(::fileno(file)) != 0) {
+        std::fclose(file);
+        throw std::runtime_error("failed to write checkpoint " + temporary.string());
+    }
+    if (std::fclose(file) != 0)
+        throw std::runtime_error("failed to write checkpoint " + temporary.string());
+    std::filesystem::rename(temporary, path);
+    sync(path.has_parent_path() ? path.parent_path() : ".", O_RDONLY | O_DIRECTORY);
+}
+
+// save for checkpoints taken while searching: a failure is reported and the
+// search goes on, so a full disk does not end it. Returns whether it was saved.
+template<typename F>
+static bool try_save(const std::filesystem::path& path, const std::uint64_t fingerprint, const F& write_body)
+{
+    try {
+        save(path, fingerprint, write_body);
+        return true;
+    } catch(const std::exception& e) {
+        std::println(stderr, "checkpoint not written, trying again later: {}", e.what());
+        return false;
+    }
+}
+
+// Returns false when there is no checkpoint at path, and throws
+// invalid_checkpoint when it cannot be resumed from.
+template<typename F>
+static bool load(const std::filesystem::path& path, const std::uint64_t fingerprint, const F& read_body)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    try {
+        reader r{ file };
+        char magic[16];
+        const auto magic_length = r.get_bytes(magic, sizeof(magic));
+        if (std::string_view{ magic, magic_length } != MAGIC || r.get<std::uint32_t>() != VERSION)
+            throw invalid_checkpoint("not a checkpoint");
+        if (r.get<std::uint64_t>() != fingerprint)
+            throw invalid_checkpoint("belongs to a different search");
+        read_body(r);
+    } catch(const invalid_checkpoint& e) {
+        std::fclose(file);
+        throw invalid_checkpoint("checkpoint " + path.string() + ": " + e.what());
+    } catch(...) {
+        std::fclose(file);
+        throw;
+    }
+
+    std::fclose(file);
+    return true;
+}
+
+}
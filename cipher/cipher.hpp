@@ -2,8 +2,10 @@
 
 #include <array>
 #include <cassert>
+#include <string>
 #include <string_view>
 #include <span>
+#include <vector>
 
 #include "alphabet.hpp"
 
@@ -35,6 +37,40 @@ constexpr static std::string_view to_string(const buffer_t<len, char>& buffer)
     return std::string_view{ buffer.begin(), buffer.end() };
 }
 
+// Stands in for a compile-time buffer whose contents are only known at run time.
+// It has no data members, so it can be passed anywhere a ciphertext or alphabet
+// is taken as an auto template argument. Each Tag names a separate buffer.
+template<typename Tag>
+struct runtime_buffer
+{
+    inline static std::string contents{};
+
+    std::size_t size() const { return contents.size(); }
+    char operator[](const std::size_t index) const { return contents[index]; }
+    auto begin() const { return contents.cbegin(); }
+    auto end() const { return contents.cend(); }
+};
+
+// Like runtime_buffer, for a list of buffers such as a batch of ciphertexts.
+template<typename Tag>
+struct runtime_buffer_list
+{
+    inline static std::vector<std::string> contents{};
+
+    std::size_t size() const { return contents.size(); }
+    const std::string& operator[](const std::size_t index) const { return contents[index]; }
+    auto begin() const { return contents.cbegin(); }
+    auto end() const { return contents.cend(); }
+};
+
+template<typename Tag, typename T>
+struct runtime_value
+{
+    inline static T value{};
+
+    operator T() const { return value; }
+};
+
 template<auto alphabet>
 constexpr static auto index_in_alphabet(const char c)
 {
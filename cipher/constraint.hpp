@@ -0,0 +1,288 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cipher/base64.hpp>
+#include <cipher/cipher.hpp>
+
+// Recovers a base64 substitution alphabet as a constraint problem instead of
+// filling it slot by slot in ciphertext order. Every alphabet slot that occurs in
+// the ciphertext is a variable whose domain is the set of base64 values it may
+// stand for. Two neighbouring characters of a quantum share a plaintext byte, so
+// every byte is a relation between two slots; slots are all different, and known
+// plaintext pins bytes down.
+namespace cipher::constraint
+{
+
+// Bit v is set while value v is possible.
+using domain_t = std::uint64_t;
+// relation[a] has bit b set when value a followed by value b is allowed.
+using relation_t = std::array<std::uint64_t, 64>;
+using domains_t = std::array<domain_t, 64>;
+
+constexpr static domain_t bit(const std::size_t index)
+{
+    return domain_t{ 1 } << index;
+}
+
+// The plaintext byte that two neighbouring values of a quantum make up. phase is
+// the position of the first value in its quantum, 0 to 2.
+constexpr static char byte_of(const std::size_t phase, const std::uint8_t first, const std::uint8_t second)
+{
+    const auto shift = 2 * phase;
+    return static_cast<char>((first << (2 + shift)) | (second >> (4 - shift)));
+}
+
+template<typename Accept>
+constexpr static relation_t byte_relation(const std::size_t phase, const Accept& accept)
+{
+    relation_t relation{};
+    for(std::uint8_t a = 0; a < 64; a++)
+        for(std::uint8_t b = 0; b < 64; b++)
+            if (accept(byte_of(phase, a, b)))
+                relation[a] |= bit(b);
+    return relation;
+}
+
+// Known plaintext at a byte offset.
+struct crib
+{
+    std::size_t offset;
+    std::string_view plaintext;
+};
+
+struct problem
+{
+    struct constraint
+    {
+        std::uint8_t first;
+        std::uint8_t second;
+        std::uint16_t relation;
+    };
+
+    // The ciphertext as slots, up to the first character outside the alphabet.
+    std::vector<std::uint8_t> text;
+    std::vector<relation_t> relations;
+    std::vector<constraint> constraints;
+    std::array<std::vector<std::uint16_t>, 64> watched_by;
+    domains_t domains;
+    // Slots that occur in the ciphertext.
+    domain_t variables{ 0 };
+
+    constexpr problem()
+    {
+        domains.fill(~domain_t{ 0 });
+    }
+
+    constexpr std::uint16_t add_relation(const relation_t& relation)
+    {
+        const auto found = std::find(relations.begin(), relations.end(), relation);
+        if (found != relations.end())
+            return static_cast<std::uint16_t>(found - relations.begin());
+        relations.push_back(relation);
+        return static_cast<std::uint16_t>(relations.size() - 1);
+    }
+
+    // A slot next to itself only allows values related to themselves, which is
+    // checked once here instead of on every propagation.
+    constexpr void add_constraint(const std::uint8_t first, const std::uint8_t second, const std::uint16_t relation)
+    {
+        if (first == second) {
+            domain_t allowed{ 0 };
+            for(auto v = 0u; v < 64; v++)
+                if ((relations[relation][v] & bit(v)) != 0)
+                    allowed |= bit(v);
+            domains[first] &= allowed;
+            return;
+        }
+        for(const auto& c : constraints)
+            if (c.first == first && c.second == second && c.relation == relation)
+                return;
+        constraints.push_back({ first, second, relation });
+        watched_by[first].push_back(static_cast<std::uint16_t>(constraints.size() - 1));
+        watched_by[second].push_back(static_cast<std::uint16_t>(constraints.size() - 1));
+    }
+};
+
+// Slots are the positions of the ciphertext characters in the standard base64
+// alphabet, as in translate_plaintext_substitution. Every plaintext byte must
+// pass heuristic and the cribs, and the bits left over at the end of a short
+// last quantum must be zero.
+template<auto ciphertext, auto heuristic>
+constexpr static problem create_problem(const std::vector<crib>& cribs = {})
+{
+    problem p;
+    for(const auto c : ciphertext) {
+        const auto slot = cipher::base64::DEFAULT_ASCII_TO_VALUE_ARRAY[static_cast<std::uint8_t>(c)];
+        if (slot >= 64)
+            break;
+        p.text.push_back(slot);
+        p.variables |= bit(slot);
+    }
+
+    std::array<std::uint16_t, 3> printable;
+    for(auto phase = 0u; phase < 3; phase++)
+        printable[phase] = p.add_relation(byte_relation(phase, heuristic));
+
+    // Byte i is made of the characters first and first + 1.
+    const auto first_of = [](const std::size_t byte) { return byte / 3 * 4 + byte % 3; };
+    for(auto byte = 0u; first_of(byte) + 1 < p.text.size(); byte++) {
+        const auto first = first_of(byte);
+        p.add_constraint(p.text[first], p.text[first + 1], printable[byte % 3]);
+    }
+
+    for(const auto& crib : cribs) {
+        for(auto i = 0u; i < crib.plaintext.size(); i++) {
+            const auto byte = crib.offset + i;
+            const auto first = first_of(byte);
+            if (first + 1 >= p.text.size())
+                break;
+            const auto relation = p.add_relation(byte_relation(byte % 3, [&](const char c) { return c == crib.plaintext[i]; }));
+            p.add_constraint(p.text[first], p.text[first + 1], relation);
+        }
+    }
+
+    domain_t padding{ ~domain_t{ 0 } };
+    for(auto v = 0u; v < 64; v++) {
+        if (p.text.size() % 4 == 2 && (v & 0x0f) != 0)
+            padding &= ~bit(v);
+        if (p.text.size() % 4 == 3 && (v & 0x03) != 0)
+            padding &= ~bit(v);
+    }
+    if (!p.text.empty())
+        p.domains[p.text.back()] &= padding;
+
+    return p;
+}
+
+// Arc consistency over the byte relations plus the all-different rule for slots
+// that are decided. pending holds the slots whose domain changed. Returns false
+// once a domain runs empty.
+constexpr static bool propagate(const problem& p, domains_t& domains, domain_t pending)
+{
+    const auto narrow = [&](const std::size_t slot, const domain_t domain) {
+        if (domain == domains[slot])
+            return true;
+        domains[slot] = domain;
+        pending |= bit(slot);
+        return domain != 0;
+    };
+
+    while(pending != 0) {
+        const auto slot = static_cast<std::size_t>(std::countr_zero(pending));
+        pending &= pending - 1;
+        const auto domain = domains[slot];
+        if (domain == 0)
+            return false;
+
+        if (std::has_single_bit(domain))
+            for(auto others = p.variables & ~bit(slot); others != 0; others &= others - 1) {
+                const auto other = static_cast<std::size_t>(std::countr_zero(others));
+                if (!narrow(other, domains[other] & ~domain))
+                    return false;
+            }
+
+        for(const auto index : p.watched_by[slot]) {
+            const auto& c = p.constraints[index];
+            const auto& relation = p.relations[c.relation];
+            // Only the other slot can lose support when this one shrinks.
+            if (c.first == slot) {
+                domain_t second{ 0 };
+                for(auto values = domains[c.first]; values != 0; values &= values - 1)
+                    second |= relation[static_cast<std::size_t>(std::countr_zero(values))];
+                if (!narrow(c.second, domains[c.second] & second))
+                    return false;
+            } else {
+                domain_t first{ 0 };
+                for(auto values = domains[c.first]; values != 0; values &= values - 1) {
+                    const auto value = static_cast<std::size_t>(std::countr_zero(values));
+                    if ((relation[value] & domains[c.second]) != 0)
+                        first |= bit(value);
+                }
+                if (!narrow(c.first, first))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Picks the undecided slot with the fewest values left, tries each of them and
+// propagates. you_win gets the domains once every slot is decided.
+template<auto you_win, auto progress_report>
+constexpr static void solve(const problem& p, const domains_t& domains)
+{
+    progress_report(domains);
+
+    auto best = 64u;
+    auto best_count = 65;
+    auto undecided = 0u;
+    for(auto slots = p.variables; slots != 0; slots &= slots - 1) {
+        const auto slot = static_cast<unsigned>(std::countr_zero(slots));
+        const auto count = std::popcount(domains[slot]);
+        if (count > 1) {
+            undecided++;
+            if (count < best_count) {
+                best = slot;
+                best_count = count;
+            }
+        }
+    }
+    if (best == 64) {
+        you_win(domains);
+        return;
+    }
+
+    // The domains are consistent, so with a single slot left every value of it
+    // is a solution.
+    for(auto values = domains[best]; values != 0; values &= values - 1) {
+        auto next = domains;
+        next[best] = values & -values;
+        if (undecided == 1)
+            you_win(next);
+        else if (propagate(p, next, bit(best)))
+            solve<you_win, progress_report>(p, next);
+    }
+}
+
+template<auto you_win, auto progress_report>
+constexpr static void solve(const problem& p)
+{
+    auto domains = p.domains;
+    if (propagate(p, domains, p.variables))
+        solve<you_win, progress_report>(p, domains);
+}
+
+// Laid out like base64_alphabet_bruteforce_state::alphabet: slot i holds the
+// base64 character it stands for, '_' where the ciphertext does not decide it.
+constexpr static std::string alphabet_of(const problem& p, const domains_t& domains)
+{
+    std::string alphabet(64, '_');
+    for(auto slots = p.variables; slots != 0; slots &= slots - 1) {
+        const auto slot = static_cast<std::size_t>(std::countr_zero(slots));
+        if (std::has_single_bit(domains[slot]))
+            alphabet[slot] = cipher::base64::DEFAULT_ALPHABET[static_cast<std::size_t>(std::countr_zero(domains[slot]))];
+    }
+    return alphabet;
+}
+
+constexpr static std::string plaintext_of(const problem& p, const domains_t& domains)
+{
+    const auto value = [&](const std::size_t index) {
+        return static_cast<std::uint8_t>(std::countr_zero(domains[p.text[index]]));
+    };
+    std::string plaintext;
+    for(auto byte = 0u; byte / 3 * 4 + byte % 3 + 1 < p.text.size(); byte++) {
+        const auto first = byte / 3 * 4 + byte % 3;
+        plaintext.push_back(byte_of(byte % 3, value(first), value(first + 1)));
+    }
+    return plaintext;
+}
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cipher/base64.hpp>
+
+// Key recovery for a repeating-key Vigenère over base64 that fits every key
+// character on its own. A key character only decodes the ciphertext characters
+// of its column, so each column can be scored against a plaintext model alone,
+// and only the best keys built from the column winners need checking.
+namespace cipher::frequency
+{
+
+// log10 probability of every base64 value at each of the four positions of a
+// quantum, for plaintext that starts on a quantum.
+struct base64_model
+{
+    std::array<std::array<float, 64>, 4> log_probabilities{};
+
+    static base64_model from_counts(const std::array<std::array<double, 64>, 4>& counts)
+    {
+        base64_model m;
+        for(auto phase = 0u; phase < 4; phase++) {
+            double total{ 0 };
+            for(const auto count : counts[phase])
+                total += count;
+            // Values the plaintext never makes still get a small probability, so
+            // one odd character does not sink a column.
+            const auto floor = static_cast<float>(std::log10(0.01 / std::max(total, 1.)));
+            for(auto v = 0u; v < 64; v++)
+                m.log_probabilities[phase][v] = counts[phase][v] == 0
+                    ? floor
+                    : static_cast<float>(std::log10(counts[phase][v] / total));
+        }
+        return m;
+    }
+
+    // Plaintext bytes drawn independently with the given weights. A quantum's
+    // middle values each take bits from two neighbouring bytes.
+    static base64_model from_bytes(const std::array<double, 256>& weights)
+    {
+        std::array<std::array<double, 64>, 4> counts{};
+        for(auto a = 0u; a < 256; a++) {
+            counts[0][a >> 2] += weights[a];
+            counts[3][a & 0x3f] += weights[a];
+            for(auto b = 0u; b < 256; b++) {
+                counts[1][(a & 0x03) << 4 | b >> 4] += weights[a] * weights[b];
+                counts[2][(a & 0x0f) << 2 | b >> 6] += weights[a] * weights[b];
+            }
+        }
+        return from_counts(counts);
+    }
+
+    // Every byte the plaintext alphabet accepts is equally likely.
+    template<typename Accept>
+    static base64_model from_alphabet(const Accept& accept)
+    {
+        std::array<double, 256> weights{};
+        for(auto c = 0u; c < 256; c++)
+            weights[c] = accept(static_cast<char>(c)) ? 1. : 0.;
+        return from_bytes(weights);
+    }
+
+    // Counts the quanta starting at every byte of a sample text.
+    static base64_model from_text(const std::string_view text)
+    {
+        std::array<std::array<double, 64>, 4> counts{};
+        for(auto i = 0u; i + 3 <= text.size(); i++) {
+            const auto a = static_cast<std::uint8_t>(text[i]);
+            const auto b = static_cast<std::uint8_t>(text[i + 1]);
+            const auto c = static_cast<std::uint8_t>(text[i + 2]);
+            counts[0][a >> 2]++;
+            counts[1][(a & 0x03) << 4 | b >> 4]++;
+            counts[2][(b & 0x0f) << 2 | c >> 6]++;
+            counts[3][c & 0x3f]++;
+        }
+        return from_counts(counts);
+    }
+
+    constexpr float score(const std::size_t ciphertext_index, const char base64_char) const
+    {
+        const auto value = cipher::base64::DEFAULT_ASCII_TO_VALUE_ARRAY[static_cast<std::uint8_t>(base64_char)];
+        return value < 64 ? log_probabilities[ciphertext_index % 4][value] : log_probabilities[0][0] - 2.f;
+    }
+};
+
+struct candidate
+{
+    char key_char;
+    float score;
+};
+
+// Scores every key character for one column of a key of length period, best
+// first. decode(key, index) is the base64 character at ciphertext index, as in
+// key_plaintext; it is given a key of just the candidate character.
+template<auto decode, typename KeyAlphabet>
+constexpr static std::vector<candidate> score_column(const base64_model& model,
+                                           const KeyAlphabet& key_alphabet,
+                                           const std::size_t ciphertext_size,
+                                           const std::size_t period,
+                                           const std::size_t column)
+{
+    std::vector<candidate> candidates;
+    for(const char key_char : key_alphabet) {
+        float score{ 0 };
+        for(auto i = column; i < ciphertext_size; i += period)
+            score += model.score(i, decode(std::string_view{ &key_char, 1 }, i));
+        // After every candidate scoring as well, so ties keep key alphabet order.
+        const auto at = std::upper_bound(candidates.begin(), candidates.end(), score, [](const float a, const auto& b) {
+            return a > b.score;
+        });
+        candidates.insert(at, { key_char, score });
+    }
+    return candidates;
+}
+
+// Keys made of one candidate per column, in order of falling total score, until
+// limit keys were produced or you_win returns false. Every key comes up once:
+// a key's parent is the key with its last non-best column one candidate better.
+template<typename YouWin>
+constexpr static void best_keys(const std::vector<std::vector<candidate>>& columns, const std::size_t limit, const YouWin& you_win)
+{
+    struct node
+    {
+        float score;
+        std::vector<std::uint8_t> ranks;
+        std::size_t last;
+
+        constexpr bool operator<(const node& other) const
+        {
+            return score < other.score;
+        }
+    };
+
+    if (columns.empty() || std::any_of(columns.begin(), columns.end(), [](const auto& c) { return c.empty(); }))
+        return;
+
+    node first{ 0, std::vector<std::uint8_t>(columns.size(), 0), 0 };
+    for(const auto& column : columns)
+        first.score += column[0].score;
+    // A max-heap, as std::priority_queue keeps it.
+    std::vector<node> queue;
+    queue.push_back(std::move(first));
+
+    std::string key(columns.size(), '\0');
+    for(auto produced = 0u; produced < limit && !queue.empty(); produced++) {
+        std::pop_heap(queue.begin(), queue.end());
+        const auto best = std::move(queue.back());
+        queue.pop_back();
+        for(auto i = 0u; i < columns.size(); i++)
+            key[i] = columns[i][best.ranks[i]].key_char;
+        if (!you_win(std::string_view{ key }, best.score))
+            return;
+
+        for(auto i = best.last; i < columns.size(); i++) {
+            if (best.ranks[i] + 1u >= columns[i].size())
+                continue;
+            auto next = best;
+            next.ranks[i]++;
+            next.score += columns[i][next.ranks[i]].score - columns[i][best.ranks[i]].score;
+            next.last = i;
+            queue.push_back(std::move(next));
+            std::push_heap(queue.begin(), queue.end());
+        }
+    }
+}
+
+// A key that repeats a shorter key was already tried at that length.
+constexpr static bool is_repeat(const std::string_view key)
+{
+    for(auto period = 1u; period < key.size(); period++)
+        if (key.size() % period == 0 && key.substr(period) == key.substr(0, key.size() - period))
+            return true;
+    return false;
+}
+
+}
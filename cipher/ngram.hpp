@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cipher::ngram
+{
+
+// Letters are case folded, whitespace is one class and everything else shares
+// the last class, which a language corpus rarely or never contains.
+constexpr static const std::size_t CLASS_COUNT = 28;
+constexpr static const std::uint8_t SPACE_CLASS = 26;
+constexpr static const std::uint8_t OTHER_CLASS = 27;
+
+constexpr static std::uint8_t char_class(const char c)
+{
+    if (c >= 'a' && c <= 'z') return static_cast<std::uint8_t>(c - 'a');
+    if (c >= 'A' && c <= 'Z') return static_cast<std::uint8_t>(c - 'A');
+    if (c == ' ' || c == '\n' || c == '\r' || c == '\t') return SPACE_CLASS;
+    return OTHER_CLASS;
+}
+
+template<std::size_t N>
+constexpr static std::size_t table_size()
+{
+    std::size_t size = 1;
+    for(auto i = 0u; i < N; i++)
+        size *= CLASS_COUNT;
+    return size;
+}
+
+// log10 probabilities of every N-gram over the character classes, with a floor
+// for grams the corpus never contains.
+template<std::size_t N>
+struct model
+{
+    constexpr static const std::size_t TABLE_SIZE = table_size<N>();
+
+    std::vector<float> log_probabilities = std::vector<float>(TABLE_SIZE, 0.f);
+    // Average log10 probability per gram below which plausible() rejects.
+    float threshold{ -7.f };
+    // Number of most recent grams averaged by plausible(). Wider than N so that a
+    // single punctuation character, which sits in N floor grams, is tolerated.
+    std::size_t window{ 8 };
+
+    static model from_text(const std::string_view text)
+    {
+        std::vector<std::uint32_t> counts(TABLE_SIZE, 0);
+        std::size_t total{ 0 };
+        std::size_t index{ 0 };
+        std::size_t length{ 0 };
+        std::uint8_t previous{ SPACE_CLASS };
+        for(const auto c : text) {
+            const auto cls = char_class(c);
+            // Runs of whitespace (one word per line, blank lines) count once.
+            if (cls == SPACE_CLASS && previous == SPACE_CLASS && length != 0)
+                continue;
+            previous = cls;
+            index = (index * CLASS_COUNT + cls) % TABLE_SIZE;
+            if (++length >= N) {
+                counts[index]++;
+                total++;
+            }
+        }
+
+        if (total == 0)
+            throw std::runtime_error("corpus is too short to build an n-gram model");
+
+        model m;
+        const auto floor = std::log10(0.01f / static_cast<float>(total));
+        for(auto i = 0u; i < TABLE_SIZE; i++)
+            m.log_probabilities[i] = counts[i] == 0
+                ? floor
+                : std::log10(static_cast<float>(counts[i]) / static_cast<float>(total));
+        return m;
+    }
+
+    static model from_file(const std::filesystem::path& path)
+    {
+        std::ifstream file{ path, std::ios::binary };
+        if (!file)
+            throw std::runtime_error("failed to open corpus " + path.string());
+        const std::string text{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+        return from_text(text);
+    }
+
+    // log10 probability of the gram made of the N characters starting at gram.
+    constexpr float gram(const char* gram) const
+    {
+        std::size_t index{ 0 };
+        for(auto i = 0u; i < N; i++)
+            index = index * CLASS_COUNT + char_class(gram[i]);
+        return log_probabilities[index];
+    }
+
+    constexpr float score(const std::string_view text) const
+    {
+        float total{ 0 };
+        for(auto i = 0u; i + N <= text.size(); i++)
+            total += gram(text.data() + i);
+        return total;
+    }
+
+    // Average log10 probability per gram, comparable between texts of different
+    // length. The text is scored as if it followed a word break, so even a text
+    // shorter than N gets a meaningful score.
+    constexpr float average(const std::string_view text) const;
+
+    // Like gram(), for any text that can be indexed, such as a text_window.
+    template<typename Text>
+    constexpr float gram(const Text& text, const std::size_t start) const
+    {
+        std::size_t index{ 0 };
+        for(auto i = 0u; i < N; i++)
+            index = index * CLASS_COUNT + char_class(text[start + i]);
+        return log_probabilities[index];
+    }
+
+    // Checks the grams ending at plaintext[index], the character that was just
+    // appended. Costs at most window gram lookups regardless of how long the
+    // plaintext is, and accepts everything until the first gram is complete.
+    // Reads the window + N - 1 characters ending at index.
+    template<typename Text>
+    constexpr bool plausible(const Text& plaintext, const std::size_t index) const
+    {
+        float total{ 0 };
+        std::size_t grams{ 0 };
+        for(; grams < window && index >= grams + N - 1; grams++)
+            total += gram(plaintext, index - grams - (N - 1));
+        return grams == 0 || total >= threshold * static_cast<float>(grams);
+    }
+};
+
+// Running score of a growing plaintext. push() folds in one character in O(1).
+template<std::size_t N>
+struct scorer
+{
+    const model<N>* m;
+    std::size_t index{ 0 };
+    std::size_t length{ 0 };
+    float score{ 0 };
+
+    constexpr float push(const char c)
+    {
+        index = (index * CLASS_COUNT + char_class(c)) % model<N>::TABLE_SIZE;
+        if (++length >= N)
+            score += m->log_probabilities[index];
+        return score;
+    }
+
+    constexpr float average() const
+    {
+        return length < N ? 0.f : score / static_cast<float>(length - N + 1);
+    }
+};
+
+template<std::size_t N>
+constexpr float model<N>::average(const std::string_view text) const
+{
+    scorer<N> s{ this };
+    for(auto i = 1u; i < N; i++)
+        s.push(' ');
+    for(const auto c : text)
+        s.push(c);
+    return s.average();
+}
+
+}
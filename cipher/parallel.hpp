@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace cipher::parallel
+{
+
+static std::size_t default_thread_count()
+{
+    return std::max<std::size_t>(1u, std::thread::hardware_concurrency());
+}
+
+// Task indices owned by one worker. The owner pops from the front, so it walks
+// its block in order; thieves take from the back, furthest away from the owner.
+struct work_stealing_queue
+{
+    std::mutex mutex;
+    std::deque<std::size_t> tasks;
+
+    std::optional<std::size_t> pop()
+    {
+        std::lock_guard lock{ mutex };
+        if (tasks.empty())
+            return std::nullopt;
+        const auto task = tasks.front();
+        tasks.pop_front();
+        return task;
+    }
+
+    std::optional<std::size_t> steal()
+    {
+        std::lock_guard lock{ mutex };
+        if (tasks.empty())
+            return std::nullopt;
+        const auto task = tasks.back();
+        tasks.pop_back();
+        return task;
+    }
+};
+
+// Runs run(task_index) for every task in [0, task_count) on thread_count workers.
+// Every worker starts with a contiguous block of tasks and steals from the others
+// once its own block is drained.
+template<typename F>
+static void for_each_task(const std::size_t task_count, std::size_t thread_count, const F& run)
+{
+    thread_count = std::clamp<std::size_t>(thread_count, 1u, std::max<std::size_t>(task_count, 1u));
+
+    std::vector<work_stealing_queue> queues(thread_count);
+    for(auto i = 0u; i < thread_count; i++)
+        for(auto task = task_count * i / thread_count; task < task_count * (i + 1) / thread_count; task++)
+            queues[i].tasks.push_back(task);
+
+    const auto worker = [&](const std::size_t self) {
+        for(;;) {
+            auto task = queues[self].pop();
+            for(auto i = 1u; !task && i < thread_count; i++)
+                task = queues[(self + i) % thread_count].steal();
+            if (!task)
+                return;
+            run(*task);
+        }
+    };
+
+    std::vector<std::jthread> threads;
+    threads.reserve(thread_count - 1);
+    for(auto i = 1u; i < thread_count; i++)
+        threads.emplace_back(worker, i);
+    worker(0);
+}
+
+}
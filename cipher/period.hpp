@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "alphabet.hpp"
+
+// Key period estimation for a repeating-key Vigenère. Characters are compared by
+// their index in the cipher alphabet, so the ciphertext alphabet can be anything
+// an ascii_to_index_t maps.
+namespace cipher::period
+{
+
+constexpr static const float DIVISOR_SHARE = 0.6f;
+
+struct estimate
+{
+    std::size_t period;
+    // Index of coincidence of the columns, averaged and scaled by the alphabet
+    // size: about 1 for text that looks random at this period.
+    float coincidence;
+    // Share of the Kasiski repeat distances that the period divides.
+    float kasiski;
+    float score;
+};
+
+// Index of coincidence of the period columns of text: the share of character
+// pairs within a column that match. Pairs are pooled over all columns rather
+// than averaging per column, so long periods with a handful of characters per
+// column do not swing the result.
+template<typename Text>
+constexpr static float column_coincidence(const Text& text,
+                                          const cipher::alphabet::ascii_to_index_t& ascii_to_index,
+                                          const std::size_t alphabet_size,
+                                          const std::size_t period)
+{
+    std::uint64_t matching{ 0 };
+    std::uint64_t pairs{ 0 };
+    for(std::size_t column = 0; column < period; column++) {
+        std::array<std::uint32_t, 256> counts{};
+        std::uint64_t length{ 0 };
+        for(auto i = column; i < text.size(); i += period) {
+            counts[ascii_to_index[static_cast<std::uint8_t>(text[i])]]++;
+            length++;
+        }
+        for(const std::uint64_t count : counts)
+            matching += count * (count - (count != 0 ? 1 : 0)) / 2;
+        pairs += length * (length - (length != 0 ? 1 : 0)) / 2;
+    }
+    return pairs == 0 ? 0.f : static_cast<float>(matching) / static_cast<float>(pairs) * static_cast<float>(alphabet_size);
+}
+
+// Votes per period: every distance between two occurrences of the same run of
+// length characters counts for each period up to max_period whose columns, see
+// rank, divide it. votes[0] is the number of distances. Runs are sorted with
+// their offsets, so each occurrence of a run comes right after the one before.
+template<typename Text>
+constexpr static std::vector<std::size_t> kasiski_votes(const Text& text,
+                                                        const cipher::alphabet::ascii_to_index_t& ascii_to_index,
+                                                        const std::size_t max_period,
+                                                        const std::size_t plaintext_period,
+                                                        const std::size_t length = 3)
+{
+    std::vector<std::size_t> votes(max_period + 1, 0);
+    std::vector<std::pair<std::uint64_t, std::size_t>> runs;
+    for(auto i = 0u; i + length <= text.size(); i++) {
+        std::uint64_t key{ 0 };
+        for(auto j = 0u; j < length; j++)
+            key = key << 8 | ascii_to_index[static_cast<std::uint8_t>(text[i + j])];
+        runs.emplace_back(key, i);
+    }
+    std::sort(runs.begin(), runs.end());
+    for(auto i = 1u; i < runs.size(); i++) {
+        if (runs[i].first != runs[i - 1].first)
+            continue;
+        const auto distance = runs[i].second - runs[i - 1].second;
+        for(auto period = 1u; period <= max_period; period++)
+            if (distance % std::lcm(period, plaintext_period) == 0)
+                votes[period]++;
+        votes[0]++;
+    }
+    return votes;
+}
+
+// Periods 1 to max_period, most likely first. The plaintext can be periodic
+// itself: base64 of text is, with plaintext_period 4, since each of the four
+// characters of a quantum has its own distribution. Columns are then taken at
+// lcm(period, plaintext_period) so that every column has one key character and
+// one plaintext phase.
+//
+// Multiples of the true period score as well as it does or, with few characters
+// per column, better. So a period's divisors that score at least
+// DIVISOR_SHARE of it are ranked right before it; they are also far cheaper to
+// search.
+//
+// A period whose columns hold a single character each says nothing and is left
+// out, so text no longer than plaintext_period gets no periods at all.
+template<typename Text>
+constexpr static std::vector<estimate> rank(const Text& text,
+                                  const cipher::alphabet::ascii_to_index_t& ascii_to_index,
+                                  const std::size_t alphabet_size,
+                                  const std::size_t max_period,
+                                  const std::size_t plaintext_period = 1)
+{
+    const auto votes = kasiski_votes(text, ascii_to_index, max_period, plaintext_period);
+    std::vector<estimate> estimates;
+    for(auto period = 1u; period <= max_period; period++) {
+        const auto columns = std::lcm(period, plaintext_period);
+        if (text.size() <= columns)
+            continue;
+        const auto coincidence = column_coincidence(text, ascii_to_index, alphabet_size, columns);
+        const auto kasiski = votes[0] == 0 ? 0.f : static_cast<float>(votes[period]) / static_cast<float>(votes[0]);
+        estimates.push_back({ period, coincidence, kasiski, coincidence * (1.f + kasiski) });
+    }
+    std::sort(estimates.begin(), estimates.end(), [](const auto& a, const auto& b) {
+        return a.score > b.score || (a.score == b.score && a.period < b.period);
+    });
+
+    std::vector<estimate> ranked;
+    std::vector<bool> placed(max_period + 1, false);
+    for(const auto& e : estimates) {
+        for(auto divisor = 1u; divisor < e.period; divisor++) {
+            if (e.period % divisor != 0 || placed[divisor])
+                continue;
+            const auto d = std::find_if(estimates.begin(), estimates.end(), [&](const auto& x) { return x.period == divisor; });
+            if (d != estimates.end() && d->score >= DIVISOR_SHARE * e.score) {
+                ranked.push_back(*d);
+                placed[divisor] = true;
+            }
+        }
+        if (!placed[e.period]) {
+            ranked.push_back(e);
+            placed[e.period] = true;
+        }
+    }
+    return ranked;
+}
+
+}
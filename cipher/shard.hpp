@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cipher/checkpoint.hpp>
+
+// Messages between a search coordinator and its worker processes over a unix
+// socket. Every message is a type byte, a u32 payload length and the payload.
+// Payloads use the checkpoint writer and reader, so states travel in the same
+// format they are checkpointed in.
+namespace cipher::shard
+{
+
+enum class message_type : std::uint8_t
+{
+    // worker -> coordinator: u64 search fingerprint
+    hello = 1,
+    // coordinator -> worker: u64 first task, u64 task count, the task states
+    shard,
+    // worker -> coordinator: u64 task, the state that reached you_win
+    hit,
+    // worker -> coordinator: u64 nodes searched; the shard is complete
+    done,
+    // coordinator -> worker: no work is left
+    quit,
+};
+
+struct message
+{
+    message_type type;
+    std::string payload;
+};
+
+static bool write_all(const int fd, const char* data, std::size_t length)
+{
+    while(length != 0) {
+        const auto written = ::send(fd, data, length, MSG_NOSIGNAL);
+        if (written <= 0)
+            return false;
+        data += written;
+        length -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+static bool read_all(const int fd, char* data, std::size_t length)
+{
+    while(length != 0) {
+        const auto received = ::recv(fd, data, length, 0);
+        if (received <= 0)
+            return false;
+        data += received;
+        length -= static_cast<std::size_t>(received);
+    }
+    return true;
+}
+
+// Returns false when the other side is gone.
+static bool send_message(const int fd, const message_type type, const std::string_view payload = {})
+{
+    char header[5];
+    header[0] = static_cast<char>(type);
+    const auto length = static_cast<std::uint32_t>(payload.size());
+    std::memcpy(header + 1, &length, sizeof(length));
+    return write_all(fd, header, sizeof(header)) && write_all(fd, payload.data(), payload.size());
+}
+
+static std::optional<message> receive_message(const int fd)
+{
+    char header[5];
+    if (!read_all(fd, header, sizeof(header)))
+        return std::nullopt;
+    std::uint32_t length;
+    std::memcpy(&length, header + 1, sizeof(length));
+    message m{ static_cast<message_type>(header[0]), std::string(length, '\0') };
+    if (!read_all(fd, m.payload.data(), length))
+        return std::nullopt;
+    return m;
+}
+
+template<typename F>
+static std::string encode(const F& write_body)
+{
+    char* buffer{ nullptr };
+    std::size_t size{ 0 };
+    std::FILE* file = open_memstream(&buffer, &size);
+    if (file == nullptr)
+        throw std::runtime_error("failed to encode message");
+    try {
+        checkpoint::writer w{ file };
+        write_body(w);
+    } catch(...) {
+        std::fclose(file);
+        std::free(buffer);
+        throw;
+    }
+    std::fclose(file);
+    std::string payload{ buffer, size };
+    std::free(buffer);
+    return payload;
+}
+
+template<typename F>
+static void decode(std::string& payload, const F& read_body)
+{
+    if (payload.empty())
+        throw std::runtime_error("empty message");
+    std::FILE* file = fmemopen(payload.data(), payload.size(), "rb");
+    if (file == nullptr)
+        throw std::runtime_error("failed to decode message");
+    try {
+        checkpoint::reader r{ file };
+        read_body(r);
+    } catch(...) {
+        std::fclose(file);
+        throw;
+    }
+    std::fclose(file);
+}
+
+static sockaddr_un unix_address(const std::filesystem::path& path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.native().size() >= sizeof(address.sun_path))
+        throw std::runtime_error("socket path too long: " + path.string());
+    std::strcpy(address.sun_path, path.c_str());
+    return address;
+}
+
+static int listen_unix(const std::filesystem::path& path)
+{
+    const auto address = unix_address(path);
+    const auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error("failed to create socket");
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 64) != 0) {
+        ::close(fd);
+        throw std::runtime_error("failed to listen on " + path.string());
+    }
+    return fd;
+}
+
+static int connect_unix(const std::filesystem::path& path)
+{
+    const auto address = unix_address(path);
+    const auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error("failed to create socket");
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        throw std::runtime_error("failed to connect to " + path.string());
+    }
+    return fd;
+}
+
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "alphabet.hpp"
+
+// Build with -DCIPHER_SIMD=0 to always take the scalar path. Otherwise the
+// newest kernel the CPU can run is picked at run time.
+#ifndef CIPHER_SIMD
+#define CIPHER_SIMD 1
+#endif
+
+#if CIPHER_SIMD && (defined(__x86_64__) || defined(__i386__))
+#define CIPHER_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define CIPHER_SIMD_X86 0
+#endif
+
+// Non-autokey Vigenère over an alphabet, like cipher::vigenere::vigenere with
+// alphabet spans, a register of characters at a time. Characters outside the
+// alphabet count as its first character there too.
+namespace cipher::simd
+{
+
+#if CIPHER_SIMD_X86
+
+// Ordered, so a kernel can run on anything at least as new as its own.
+enum class instruction_set
+{
+    scalar,
+    ssse3,
+    sse41,
+    avx2,
+};
+
+static instruction_set detect()
+{
+    static const auto detected = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return instruction_set::avx2;
+        if (__builtin_cpu_supports("sse4.1"))
+            return instruction_set::sse41;
+        if (__builtin_cpu_supports("ssse3"))
+            return instruction_set::ssse3;
+        return instruction_set::scalar;
+    }();
+    return detected;
+}
+
+#endif
+
+struct vigenere_tables
+{
+    alphabet::ascii_to_index_t ascii_to_index{};
+    std::array<char, 256> index_to_ascii{};
+    std::uint8_t size{ 0 };
+    // The vector kernels look characters up with 16-entry shuffles, which needs
+    // an alphabet of at most 64 ASCII characters.
+    bool vectorizable{ false };
+
+    template<typename charT, std::size_t extent>
+    constexpr static vigenere_tables create(const std::span<charT, extent> alphabet)
+    {
+        vigenere_tables t;
+        t.ascii_to_index = alphabet::create_ascii_to_index_array(alphabet);
+        t.size = static_cast<std::uint8_t>(alphabet.size());
+        t.vectorizable = alphabet.size() <= 64;
+        for(auto i = 0u; i < alphabet.size(); i++) {
+            t.index_to_ascii[i] = static_cast<char>(alphabet[i]);
+            if (static_cast<std::uint8_t>(alphabet[i]) >= 128)
+                t.vectorizable = false;
+        }
+        return t;
+    }
+};
+
+// The key as alphabet indices, repeated so that a full register of them can be
+// loaded starting at any key position.
+struct key_schedule
+{
+    constexpr static const std::size_t LANES = 32;
+
+    std::vector<std::uint8_t> indices;
+    std::size_t period{ 0 };
+
+    template<typename charT, std::size_t extent>
+    constexpr static key_schedule create(const vigenere_tables& tables, const std::span<charT, extent> key)
+    {
+        key_schedule s;
+        s.period = key.size();
+        s.indices.resize(key.size() + LANES);
+        for(auto i = 0u; i < s.indices.size(); i++)
+            s.indices[i] = tables.ascii_to_index[static_cast<std::uint8_t>(key[i % key.size()])];
+        return s;
+    }
+};
+
+template<bool encode>
+constexpr static char vigenere_char(const vigenere_tables& tables, const char source, const std::uint8_t key_index)
+{
+    const auto index = tables.ascii_to_index[static_cast<std::uint8_t>(source)];
+    if constexpr (encode) {
+        const auto sum = index + key_index;
+        return tables.index_to_ascii[sum >= tables.size ? sum - tables.size : sum];
+    } else {
+        return tables.index_to_ascii[index >= key_index ? index - key_index : index + tables.size - key_index];
+    }
+}
+
+template<bool encode>
+constexpr static void vigenere_scalar(char* target, const char* source, const std::size_t begin, const std::size_t end,
+                                      const vigenere_tables& tables, const key_schedule& key)
+{
+    auto key_position = begin % key.period;
+    for(auto i = begin; i < end; i++) {
+        target[i] = vigenere_char<encode>(tables, source[i], key.indices[key_position]);
+        if (++key_position == key.period)
+            key_position = 0;
+    }
+}
+
+#if CIPHER_SIMD_X86
+
+// Each kernel handles whole registers and returns where the scalar tail starts.
+
+template<bool encode>
+__attribute__((target("sse4.1"))) static std::size_t vigenere_sse41(char* target, const char* source, const std::size_t size,
+                                                                    const vigenere_tables& tables, const key_schedule& key)
+{
+    __m128i to_index[8];
+    for(auto high = 0u; high < 8; high++)
+        to_index[high] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.ascii_to_index.data() + 16 * high));
+    __m128i to_ascii[4];
+    for(auto high = 0u; high < 4; high++)
+        to_ascii[high] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.index_to_ascii.data() + 16 * high));
+    const auto low_nibble = _mm_set1_epi8(0x0f);
+    const auto size_vector = _mm_set1_epi8(static_cast<char>(tables.size));
+
+    std::size_t i{ 0 };
+    auto key_position = 0u;
+    for(; i + 16 <= size; i += 16) {
+        const auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        const auto low = _mm_and_si128(chars, low_nibble);
+        const auto high = _mm_and_si128(_mm_srli_epi16(chars, 4), low_nibble);
+        auto index = _mm_setzero_si128();
+        for(auto h = 0; h < 8; h++)
+            index = _mm_blendv_epi8(index, _mm_shuffle_epi8(to_index[h], low), _mm_cmpeq_epi8(high, _mm_set1_epi8(static_cast<char>(h))));
+
+        const auto key_indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key.indices.data() + key_position));
+        if constexpr (encode) {
+            index = _mm_add_epi8(index, key_indices);
+            index = _mm_sub_epi8(index, _mm_and_si128(_mm_cmpgt_epi8(index, _mm_sub_epi8(size_vector, _mm_set1_epi8(1))), size_vector));
+        } else {
+            index = _mm_sub_epi8(index, key_indices);
+            index = _mm_add_epi8(index, _mm_and_si128(_mm_cmpgt_epi8(_mm_setzero_si128(), index), size_vector));
+        }
+
+        const auto index_low = _mm_and_si128(index, low_nibble);
+        const auto index_high = _mm_srli_epi16(index, 4);
+        auto result = _mm_setzero_si128();
+        for(auto h = 0; h < 4; h++)
+            result = _mm_blendv_epi8(result, _mm_shuffle_epi8(to_ascii[h], index_low),
+                                     _mm_cmpeq_epi8(_mm_and_si128(index_high, low_nibble), _mm_set1_epi8(static_cast<char>(h))));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), result);
+
+        key_position += 16;
+        while(key_position >= key.period)
+            key_position -= static_cast<unsigned>(key.period);
+    }
+    return i;
+}
+
+template<bool encode>
+__attribute__((target("avx2"))) static std::size_t vigenere_avx2(char* target, const char* source, const std::size_t size,
+                                                                 const vigenere_tables& tables, const key_schedule& key)
+{
+    __m256i to_index[8];
+    for(auto high = 0u; high < 8; high++)
+        to_index[high] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.ascii_to_index.data() + 16 * high)));
+    __m256i to_ascii[4];
+    for(auto high = 0u; high < 4; high++)
+        to_ascii[high] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.index_to_ascii.data() + 16 * high)));
+    const auto low_nibble = _mm256_set1_epi8(0x0f);
+    const auto size_vector = _mm256_set1_epi8(static_cast<char>(tables.size));
+
+    std::size_t i{ 0 };
+    auto key_position = 0u;
+    for(; i + 32 <= size; i += 32) {
+        const auto chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        const auto low = _mm256_and_si256(chars, low_nibble);
+        const auto high = _mm256_and_si256(_mm256_srli_epi16(chars, 4), low_nibble);
+        auto index = _mm256_setzero_si256();
+        for(auto h = 0; h < 8; h++)
+            index = _mm256_blendv_epi8(index, _mm256_shuffle_epi8(to_index[h], low), _mm256_cmpeq_epi8(high, _mm256_set1_epi8(static_cast<char>(h))));
+
+        const auto key_indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key.indices.data() + key_position));
+        if constexpr (encode) {
+            index = _mm256_add_epi8(index, key_indices);
+            index = _mm256_sub_epi8(index, _mm256_and_si256(_mm256_cmpgt_epi8(index, _mm256_sub_epi8(size_vector, _mm256_set1_epi8(1))), size_vector));
+        } else {
+            index = _mm256_sub_epi8(index, key_indices);
+            index = _mm256_add_epi8(index, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_setzero_si256(), index), size_vector));
+        }
+
+        const auto index_low = _mm256_and_si256(index, low_nibble);
+        const auto index_high = _mm256_and_si256(_mm256_srli_epi16(index, 4), low_nibble);
+        auto result = _mm256_setzero_si256();
+        for(auto h = 0; h < 4; h++)
+            result = _mm256_blendv_epi8(result, _mm256_shuffle_epi8(to_ascii[h], index_low), _mm256_cmpeq_epi8(index_high, _mm256_set1_epi8(static_cast<char>(h))));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i), result);
+
+        key_position += 32;
+        while(key_position >= key.period)
+            key_position -= static_cast<unsigned>(key.period);
+    }
+    return i;
+}
+
+#endif
+
+template<bool encode, typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
+constexpr static void vigenere(const std::span<charT, ex1> target,
+                               const std::span<charT2, ex2> source,
+                               const vigenere_tables& tables,
+                               const key_schedule& key)
+{
+    static_assert(sizeof(charT) == 1 && sizeof(charT2) == 1);
+    if consteval {
+        for(auto i = 0u; i < source.size(); i++)
+            target[i] = static_cast<charT>(vigenere_char<encode>(tables, static_cast<char>(source[i]), key.indices[i % key.period]));
+    } else {
+        auto* const out = reinterpret_cast<char*>(target.data());
+        const auto* const in = reinterpret_cast<const char*>(source.data());
+        std::size_t done{ 0 };
+#if CIPHER_SIMD_X86
+        if (tables.vectorizable && detect() >= instruction_set::avx2)
+            done = vigenere_avx2<encode>(out, in, source.size(), tables, key);
+        else if (tables.vectorizable && detect() >= instruction_set::sse41)
+            done = vigenere_sse41<encode>(out, in, source.size(), tables, key);
+#endif
+        vigenere_scalar<encode>(out, in, done, source.size(), tables, key);
+    }
+}
+
+template<typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
+constexpr static void encode(const std::span<charT, ex1> ciphertext,
+                             const std::span<charT2, ex2> plaintext,
+                             const vigenere_tables& tables,
+                             const key_schedule& key)
+{
+    return vigenere<true>(ciphertext, plaintext, tables, key);
+}
+
+template<typename charT, typename charT2, std::size_t ex1, std::size_t ex2>
+constexpr static void decode(const std::span<charT, ex1> plaintext,
+                             const std::span<charT2, ex2> ciphertext,
+                             const vigenere_tables& tables,
+                             const key_schedule& key)
+{
+    return vigenere<false>(plaintext, ciphertext, tables, key);
+}
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <string_view>
+#include <vector>
+
+// Build with -DCIPHER_BRUTEFORCE_STATS=1 to count search tree nodes per depth.
+// Otherwise count() and report() are empty and the counters are never allocated.
+#ifndef CIPHER_BRUTEFORCE_STATS
+#define CIPHER_BRUTEFORCE_STATS 0
+#endif
+
+namespace cipher::stats
+{
+
+constexpr static const bool ENABLED = CIPHER_BRUTEFORCE_STATS != 0;
+// Depth is the ciphertext index of the decoded character. Ciphertexts can be far
+// longer than this, but pruning is decided in the first few hundred characters,
+// so deeper nodes are all counted in the last depth.
+constexpr static const std::size_t MAX_DEPTH = 384;
+
+enum counter : std::size_t
+{
+    EXPANDED,
+    HEURISTIC_PRUNED,
+    HIGH_BIT_PRUNED,
+    COUNTER_COUNT
+};
+
+constexpr static const std::array<std::string_view, COUNTER_COUNT> COUNTER_NAMES{
+    "expanded",
+    "heuristic_pruned",
+    "high_bit_pruned",
+};
+
+// Only the owning thread writes its counters. The relaxed load and store keep
+// the increment a plain add while letting report() read them from another thread.
+struct thread_counters
+{
+    std::array<std::array<std::atomic<std::uint64_t>, MAX_DEPTH>, COUNTER_COUNT> counts{};
+
+    void add(const counter c, const std::size_t depth)
+    {
+        auto& count = counts[c][std::min(depth, MAX_DEPTH - 1)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+struct registry
+{
+    std::mutex mutex;
+    // Kept until exit, so counts of threads that already finished still add up.
+    std::vector<std::unique_ptr<thread_counters>> threads;
+    std::FILE* output{ stderr };
+    std::chrono::steady_clock::duration interval{ std::chrono::seconds{ 10 } };
+    std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+    std::chrono::steady_clock::time_point last_report{ start };
+
+    thread_counters& add_thread()
+    {
+        std::lock_guard lock{ mutex };
+        return *threads.emplace_back(std::make_unique<thread_counters>());
+    }
+
+    // One JSON object per line with the counters of all threads summed per depth.
+    // Depths past the deepest one reached are left out. Expects mutex to be held.
+    void write()
+    {
+        std::array<std::array<std::uint64_t, MAX_DEPTH>, COUNTER_COUNT> totals{};
+        for(const auto& thread : threads)
+            for(auto c = 0u; c < COUNTER_COUNT; c++)
+                for(auto depth = 0u; depth < MAX_DEPTH; depth++)
+                    totals[c][depth] += thread->counts[c][depth].load(std::memory_order_relaxed);
+
+        auto depths = MAX_DEPTH;
+        while(depths != 0 && totals[EXPANDED][depths - 1] == 0)
+            depths--;
+
+        const auto now = std::chrono::steady_clock::now();
+        std::print(output, "{{\"elapsed\":{:.3f},\"depths\":[", std::chrono::duration<double>(now - start).count());
+        for(auto depth = 0u; depth < depths; depth++) {
+            std::print(output, "{}{{\"depth\":{}", depth == 0 ? "" : ",", depth);
+            for(auto c = 0u; c < COUNTER_COUNT; c++)
+                std::print(output, ",\"{}\":{}", COUNTER_NAMES[c], totals[c][depth]);
+            const auto expanded = totals[EXPANDED][depth];
+            const auto pruned = totals[HEURISTIC_PRUNED][depth] + totals[HIGH_BIT_PRUNED][depth];
+            std::print(output, ",\"prune_rate\":{:.4f}}}", expanded == 0 ? 0. : static_cast<double>(pruned) / static_cast<double>(expanded));
+        }
+        std::println(output, "]}}");
+        std::fflush(output);
+        last_report = now;
+    }
+};
+
+inline registry global{};
+inline thread_local thread_counters* local{ nullptr };
+inline thread_local std::uint32_t ticks{ 0 };
+
+inline void count(const counter c, const std::size_t depth)
+{
+    if constexpr (ENABLED) {
+        if (local == nullptr) [[unlikely]]
+            local = &global.add_thread();
+        local->add(c, depth);
+    }
+}
+
+// Called once per node; looks at the clock every 65536 calls and writes a report
+// once global.interval has passed. A thread that finds another one reporting
+// skips instead of waiting.
+inline void tick()
+{
+    if constexpr (ENABLED) {
+        if ((++ticks & 0xffff) != 0) [[likely]]
+            return;
+        std::unique_lock lock{ global.mutex, std::try_to_lock };
+        if (lock.owns_lock() && std::chrono::steady_clock::now() - global.last_report >= global.interval)
+            global.write();
+    }
+}
+
+inline void report()
+{
+    if constexpr (ENABLED) {
+        std::lock_guard lock{ global.mutex };
+        global.write();
+    }
+}
+
+}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <print>
+#include <bit>
 #include <cstdint>
 #include <cassert>
 #include <span>
+#include <type_traits>
+#include <vector>
 
 #include "alphabet.hpp"
 
@@ -110,16 +113,33 @@ alphabet_index(const alphabet::ascii_to_index_t& ascii_to_index,
                const charT1 source_char,
                const charT2 key_char)
 {
-    const auto source = static_cast<std::uint8_t>(source_char);
-    const auto key = static_cast<std::uint8_t>(key_char);
+    const std::size_t source = ascii_to_index[static_cast<std::uint8_t>(source_char)];
+    const std::size_t key = ascii_to_index[static_cast<std::uint8_t>(key_char)];
 
-    if constexpr (encode)
-        return (ascii_to_index[source] + ascii_to_index[key]) % alphabet_length;
-
-    if (ascii_to_index[source] < ascii_to_index[key])
-        return static_cast<std::uint8_t>(alphabet_length - ascii_to_index[key] + ascii_to_index[source]);
+    // Both indexes are below alphabet_length, so a conditional subtract is all
+    // the reduction needed.
+    if constexpr (encode) {
+        const auto sum = source + key;
+        return static_cast<std::uint8_t>(sum >= alphabet_length ? sum - alphabet_length : sum);
+    }
+    return static_cast<std::uint8_t>(source >= key ? source - key : source + alphabet_length - key);
+}
 
-    return (ascii_to_index[source] - ascii_to_index[key]) % alphabet_length;
+// Same, with the alphabet length known at compile time. Power of two lengths,
+// like base64's 64, reduce with a mask.
+template<bool encode, std::size_t ALPHABET_LENGTH, typename charT1, typename charT2>
+constexpr static std::uint8_t
+alphabet_index(const alphabet::ascii_to_index_t& ascii_to_index,
+               const charT1 source_char,
+               const charT2 key_char)
+{
+    if constexpr (std::has_single_bit(ALPHABET_LENGTH)) {
+        const std::size_t source = ascii_to_index[static_cast<std::uint8_t>(source_char)];
+        const std::size_t key = ascii_to_index[static_cast<std::uint8_t>(key_char)];
+        return static_cast<std::uint8_t>((encode ? source + key : source - key) & (ALPHABET_LENGTH - 1));
+    } else {
+        return alphabet_index<encode>(ascii_to_index, ALPHABET_LENGTH, source_char, key_char);
+    }
 }
 
 template<bool autokey, bool encode,
@@ -136,7 +156,11 @@ constexpr static void vigenere(const std::span<charT, ex1> target,
     for(auto i = 0u; i < source.size(); i++) {
         const auto source_char = static_cast<std::uint8_t>(source[i]);
         const auto key_char = key_character<autokey, encode>(target, source, key, i);
-        const auto index = alphabet_index<encode>(ascii_to_index, alphabet.size(), source_char, key_char);
+        std::uint8_t index;
+        if constexpr (ex4 != std::dynamic_extent)
+            index = alphabet_index<encode, ex4>(ascii_to_index, source_char, key_char);
+        else
+            index = alphabet_index<encode>(ascii_to_index, alphabet.size(), source_char, key_char);
 
         target[i] = static_cast<charT>(alphabet[index]);
     }
@@ -162,5 +186,80 @@ constexpr static void decode(const std::span<charT, ex1> plaintext,
     return vigenere<autokey, false>(plaintext, ciphertext, key, alphabet, ascii_to_index);
 }
 
+// An alphabet array is taken as a span of its static size, so its length is a
+// compile-time constant.
+template<bool autokey, std::size_t ALPHABET_LENGTH,
+         typename charT, typename charT2, typename charT3, typename charT4,
+         std::size_t ex1, std::size_t ex2, std::size_t ex3>
+    requires std::is_integral_v<charT4>
+constexpr static void encode(const std::span<charT, ex1> ciphertext,
+                             const std::span<charT2, ex2> plaintext,
+                             const std::span<charT3, ex3> key,
+                             const alphabet::alphabet_t<ALPHABET_LENGTH, charT4>& alphabet,
+                             const alphabet::ascii_to_index_t& ascii_to_index)
+{
+    return vigenere<autokey, true>(ciphertext, plaintext, key, std::span{ alphabet }, ascii_to_index);
+}
+
+template<bool autokey, std::size_t ALPHABET_LENGTH,
+         typename charT, typename charT2, typename charT3, typename charT4,
+         std::size_t ex1, std::size_t ex2, std::size_t ex3>
+    requires std::is_integral_v<charT4>
+constexpr static void decode(const std::span<charT, ex1> plaintext,
+                             const std::span<charT2, ex2> ciphertext,
+                             const std::span<charT3, ex3> key,
+                             const alphabet::alphabet_t<ALPHABET_LENGTH, charT4>& alphabet,
+                             const alphabet::ascii_to_index_t& ascii_to_index)
+{
+    return vigenere<autokey, false>(plaintext, ciphertext, key, std::span{ alphabet }, ascii_to_index);
+}
+
+// Autokey decoding in chunks of any size. Every character's key is the
+// plaintext key.size() characters back, so only that many plaintext indexes are
+// carried from one chunk to the next and the input never has to be held whole.
+template<std::size_t ALPHABET_LENGTH, typename charT = char>
+struct autokey_decoder
+{
+    // create_decode_table over the alphabet indexes themselves: a ciphertext
+    // index and a key index give the plaintext index, which is a key index again
+    // further on. The serial chain is one lookup per character.
+    vignere_table_t<ALPHABET_LENGTH, std::uint8_t> index_table;
+    alphabet::alphabet_t<ALPHABET_LENGTH, charT> alphabet;
+    alphabet::ascii_to_index_t ascii_to_index;
+    // The key indexes of the next key.size() characters, starting at position.
+    std::vector<std::uint8_t> keys;
+    std::size_t position{ 0 };
+
+    template<typename charT2, std::size_t ex>
+    constexpr autokey_decoder(const alphabet::alphabet_t<ALPHABET_LENGTH, charT>& alphabet,
+                              const std::span<charT2, ex> key)
+        : alphabet{ alphabet },
+          ascii_to_index{ alphabet::create_ascii_to_index_array(alphabet) }
+    {
+        alphabet::alphabet_t<ALPHABET_LENGTH, std::uint8_t> indexes;
+        alphabet::ascii_to_index_t identity{};
+        for(auto i = 0u; i < ALPHABET_LENGTH; i++)
+            indexes[i] = identity[i] = static_cast<std::uint8_t>(i);
+        index_table = create_decode_table(indexes, identity);
+
+        assert(!key.empty());
+        for(const auto c : key)
+            keys.push_back(ascii_to_index[static_cast<std::uint8_t>(c)]);
+    }
+
+    // Decodes the next ciphertext.size() characters into plaintext.
+    template<typename charT2, typename charT3, std::size_t ex1, std::size_t ex2>
+    constexpr void decode(const std::span<charT2, ex1> plaintext, const std::span<charT3, ex2> ciphertext)
+    {
+        assert(plaintext.size() >= ciphertext.size());
+        for(auto i = 0u; i < ciphertext.size(); i++) {
+            const auto index = index_table[ascii_to_index[static_cast<std::uint8_t>(ciphertext[i])]][keys[position]];
+            keys[position] = index;
+            if (++position == keys.size())
+                position = 0;
+            plaintext[i] = static_cast<charT2>(alphabet[index]);
+        }
+    }
+};
 
 }
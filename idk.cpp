@@ -6,6 +6,7 @@
 #include <cipher/base64.hpp>
 #include <cipher/cipher.hpp>
 #include <cipher/entropy.hpp>
+#include <cipher/simd.hpp>
 #include <cipher/vigenere.hpp>
 #include <cipher/xor.hpp>
 
@@ -31,19 +32,27 @@ static void many_times()
     auto buffer = ciphertext;
     auto buffer2 = cipher::empty_buffer<ciphertext.size()>();
     auto b64buffer = cipher::empty_buffer<ciphertext.size() * 3 / 4>();
+    const auto tables = cipher::simd::vigenere_tables::create(std::span{ alphabet });
+    const auto key_indices = cipher::simd::key_schedule::create(tables, std::span{ key });
 
     for(auto i = 0u; i < times; i++)
     {
-        cipher::vigenere::decode<autokey>(std::span{ buffer2 },
-                                          std::span{ buffer },
-                                          std::span{ key },
-                                          alphabet,
-                                          ascii_to_value);
+        if constexpr (autokey)
+            cipher::vigenere::decode<autokey>(std::span{ buffer2 },
+                                              std::span{ buffer },
+                                              std::span{ key },
+                                              alphabet,
+                                              ascii_to_value);
+        else
+            cipher::simd::decode(std::span{ buffer2 },
+                                 std::span{ buffer },
+                                 tables,
+                                 key_indices);
         buffer = buffer2;
-        cipher::base64::decode(std::span{ b64buffer },
-                               std::span{ buffer2 });
+        const auto decoded = cipher::base64::decode_checked(std::span{ b64buffer },
+                                                            std::span{ buffer2 });
 
-        if(cipher::is_print(std::span{ b64buffer }))
+        if(!decoded.invalid && cipher::is_print(std::span{ b64buffer }))
             std::println("{}", cipher::to_string(b64buffer));
     }
 }
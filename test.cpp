@@ -2,8 +2,13 @@
 
 #include <cipher/alphabet.hpp>
 #include <cipher/base64.hpp>
+#include <cipher/bruteforce.hpp>
 #include <cipher/cipher.hpp>
+#include <cipher/constraint.hpp>
 #include <cipher/entropy.hpp>
+#include <cipher/frequency.hpp>
+#include <cipher/period.hpp>
+#include <cipher/simd.hpp>
 #include <cipher/vigenere.hpp>
 #include <cipher/xor.hpp>
 
@@ -82,6 +87,52 @@ namespace vigenere
     constexpr static auto test_vigenere_2 = decrypt_vigenere(cipher::buffer("ISWXVIBJEXIGGBOCEWKBJEVIGGQS"));
     static_assert(cipher::to_string(test_vigenere_2) == "DEFENDTHEEASTWALLOFTHECASTLE"sv, cipher::to_string(test_vigenere_2));
 
+    constexpr static auto base64_key = cipher::buffer("TheGiant");
+
+    // 64 characters, a power of two: the index arithmetic is masked.
+    template<bool encode, std::size_t len, typename charT>
+    constexpr static auto vigenere_base64(const cipher::buffer_t<len, charT>& buffer)
+    {
+        auto target = cipher::empty_buffer<len, charT>();
+        if constexpr (encode)
+            cipher::vigenere::encode<false>(std::span{ target },
+                                            std::span{ buffer },
+                                            std::span{ base64_key },
+                                            cipher::base64::DEFAULT_ALPHABET,
+                                            cipher::base64::DEFAULT_ASCII_TO_VALUE_ARRAY);
+        else
+            cipher::vigenere::decode<false>(std::span{ target },
+                                            std::span{ buffer },
+                                            std::span{ base64_key },
+                                            cipher::base64::DEFAULT_ALPHABET,
+                                            cipher::base64::DEFAULT_ASCII_TO_VALUE_ARRAY);
+        return target;
+    }
+
+    constexpr static auto test_vigenere_base64_1 = vigenere_base64<true>(cipher::buffer("SGVsbG8gV29ybGRk"));
+    static_assert(cipher::to_string(test_vigenere_base64_1) == "lnzy9gjNoXb49g4R"sv, cipher::to_string(test_vigenere_base64_1));
+
+    constexpr static auto test_vigenere_base64_2 = vigenere_base64<false>(cipher::buffer("lnzy9gjNoXb49g4R"));
+    static_assert(cipher::to_string(test_vigenere_base64_2) == "SGVsbG8gV29ybGRk"sv, cipher::to_string(test_vigenere_base64_2));
+
+    template<bool encode, std::size_t len, typename charT>
+    constexpr static auto vigenere_simd(const cipher::buffer_t<len, charT>& buffer)
+    {
+        const auto tables = cipher::simd::vigenere_tables::create(std::span{ vigenere_alphabet });
+        auto target = cipher::empty_buffer<len, charT>();
+        cipher::simd::vigenere<encode>(std::span{ target },
+                                       std::span{ buffer },
+                                       tables,
+                                       cipher::simd::key_schedule::create(tables, std::span{ key }));
+        return target;
+    }
+
+    constexpr static auto test_vigenere_simd_1 = vigenere_simd<true>(cipher::buffer("DEFENDTHEEASTWALLOFTHECASTLE"));
+    static_assert(cipher::to_string(test_vigenere_simd_1) == "ISWXVIBJEXIGGBOCEWKBJEVIGGQS"sv, cipher::to_string(test_vigenere_simd_1));
+
+    constexpr static auto test_vigenere_simd_2 = vigenere_simd<false>(cipher::buffer("ISWXVIBJEXIGGBOCEWKBJEVIGGQS"));
+    static_assert(cipher::to_string(test_vigenere_simd_2) == "DEFENDTHEEASTWALLOFTHECASTLE"sv, cipher::to_string(test_vigenere_simd_2));
+
     template<std::size_t len, typename charT>
     constexpr static auto encrypt_autokey_table(const cipher::buffer_t<len, charT>& buffer)
     {
@@ -141,11 +192,72 @@ namespace vigenere
 
     constexpr static auto test_autokey_2 = decrypt_autokey(cipher::buffer("ISWXVIBJEXIGGZEQPBIMOIGAKMHE"));
     static_assert(cipher::to_string(test_autokey_2) == "DEFENDTHEEASTWALLOFTHECASTLE"sv, cipher::to_string(test_autokey_2));
+
+    // Chunks that split the key, then one longer than it.
+    constexpr static auto decrypt_autokey_stream(const std::string_view ciphertext)
+    {
+        cipher::vigenere::autokey_decoder<vigenere_alphabet.size()> decoder{ vigenere_alphabet, std::span{ key } };
+        auto plaintext = cipher::empty_buffer<28>();
+        decoder.decode(std::span{ plaintext }.first(5), std::span{ ciphertext }.first(5));
+        decoder.decode(std::span{ plaintext }.subspan(5), std::span{ ciphertext }.subspan(5));
+        return plaintext;
+    }
+
+    constexpr static auto test_autokey_stream = decrypt_autokey_stream("ISWXVIBJEXIGGZEQPBIMOIGAKMHE"sv);
+    static_assert(cipher::to_string(test_autokey_stream) == "DEFENDTHEEASTWALLOFTHECASTLE"sv, cipher::to_string(test_autokey_stream));
 }
 
 namespace substitution
 {
-    
+    // "Hi!" in the standard alphabet, so every slot stands for itself.
+    constexpr static auto ciphertext = cipher::buffer("SGkh");
+
+    constexpr static auto printable = [](const char c) { return cipher::is_print(c); };
+    constexpr static auto anything = [](const char) { return true; };
+
+    constexpr static auto slot(const char c)
+    {
+        return cipher::base64::DEFAULT_ASCII_TO_VALUE_ARRAY[static_cast<std::uint8_t>(c)];
+    }
+
+    // The crib decides every byte, and so every slot, without any search.
+    constexpr static auto propagate_crib()
+    {
+        const auto p = cipher::constraint::create_problem<ciphertext, printable>({ { 0, "Hi!" } });
+        auto domains = p.domains;
+        if (!cipher::constraint::propagate(p, domains, p.variables))
+            return std::string{};
+        return cipher::constraint::alphabet_of(p, domains) + cipher::constraint::plaintext_of(p, domains);
+    }
+
+    static_assert(propagate_crib() == "______G___________S______________h__k___________________________Hi!"sv);
+
+    // Two cribs that disagree on byte 1 leave its slots without a value.
+    constexpr static auto propagate_conflict()
+    {
+        const auto p = cipher::constraint::create_problem<ciphertext, printable>({ { 0, "Hi" }, { 1, "o" } });
+        auto domains = p.domains;
+        return cipher::constraint::propagate(p, domains, p.variables);
+    }
+
+    static_assert(!propagate_conflict());
+
+    // With every byte allowed only all-different narrows anything: deciding S
+    // takes its value away from the other slots, and from them alone.
+    constexpr static auto propagate_decided()
+    {
+        const auto p = cipher::constraint::create_problem<ciphertext, anything>();
+        auto domains = p.domains;
+        domains[slot('S')] = cipher::constraint::bit(slot('S'));
+        if (!cipher::constraint::propagate(p, domains, cipher::constraint::bit(slot('S'))))
+            return false;
+        return domains[slot('G')] == ~cipher::constraint::bit(slot('S'))
+            && domains[slot('k')] == ~cipher::constraint::bit(slot('S'))
+            && domains[slot('h')] == ~cipher::constraint::bit(slot('S'))
+            && domains[slot('A')] == ~cipher::constraint::domain_t{ 0 };
+    }
+
+    static_assert(propagate_decided());
 }
 
 namespace base64
@@ -174,6 +286,232 @@ namespace base64
     constexpr static auto test_base64_2 = decode_b64_cexpr(cipher::buffer("SGVsbG8gV29ybGRk"));
     static_assert(cipher::to_string(test_base64_2) == "Hello Worldd"sv, cipher::to_string(test_base64_2));
 
+    template<bool padding, std::size_t len, typename charT>
+    constexpr static auto encode_b64(const cipher::buffer_t<len, charT>& buffer)
+    {
+        auto ciphertext = cipher::empty_buffer<cipher::base64::encoded_size(len, padding), charT>();
+        cipher::base64::encode<padding>(std::span{ ciphertext },
+                                        std::span{ buffer });
+        return ciphertext;
+    }
+
+    constexpr static auto test_base64_3 = encode_b64<true>(cipher::buffer("Hello Worldd"));
+    static_assert(cipher::to_string(test_base64_3) == "SGVsbG8gV29ybGRk"sv, cipher::to_string(test_base64_3));
+
+    constexpr static auto test_base64_4 = decode_b64(test_base64_3);
+    static_assert(cipher::to_string(test_base64_4) == "Hello Worldd"sv, cipher::to_string(test_base64_4));
+
+    constexpr static auto test_base64_5 = encode_b64<true>(cipher::buffer("Hello"));
+    static_assert(cipher::to_string(test_base64_5) == "SGVsbG8="sv, cipher::to_string(test_base64_5));
+
+    constexpr static auto test_base64_6 = encode_b64<false>(cipher::buffer("Hello"));
+    static_assert(cipher::to_string(test_base64_6) == "SGVsbG8"sv, cipher::to_string(test_base64_6));
+
+    // Chunks that split quanta anywhere.
+    constexpr static auto encode_b64_stream(const std::string_view plaintext)
+    {
+        cipher::base64::encoder encoder;
+        auto ciphertext = cipher::empty_buffer<16, char>();
+        auto size = encoder.update(std::span{ ciphertext }, std::span{ plaintext.substr(0, 4) });
+        size += encoder.update(std::span{ ciphertext }.subspan(size), std::span{ plaintext.substr(4, 1) });
+        size += encoder.update(std::span{ ciphertext }.subspan(size), std::span{ plaintext.substr(5) });
+        encoder.finish(std::span{ ciphertext }.subspan(size));
+        return ciphertext;
+    }
+
+    constexpr static auto test_base64_7 = encode_b64_stream("Hello World");
+    static_assert(cipher::to_string(test_base64_7) == "SGVsbG8gV29ybGQ="sv, cipher::to_string(test_base64_7));
+
+    constexpr static auto decode_b64_checked(const std::string_view ciphertext)
+    {
+        auto plaintext = cipher::empty_buffer<16, char>();
+        return cipher::base64::decode_checked(std::span{ plaintext }, std::span{ ciphertext });
+    }
+
+    static_assert(decode_b64_checked("SGVsbG8=").size == 5 && !decode_b64_checked("SGVsbG8=").invalid);
+    static_assert(decode_b64_checked("SGVsbG8").size == 5 && !decode_b64_checked("SGVsbG8").invalid);
+    static_assert(decode_b64_checked("SGVsbG8gV2*ybGQ=").invalid == 10);
+    static_assert(decode_b64_checked("SG=sbG8=").invalid == 2);
+    static_assert(decode_b64_checked("SGVsb").invalid == 4);
+
+    constexpr static auto decode_b64_stream(const std::string_view ciphertext)
+    {
+        cipher::base64::decoder decoder;
+        auto plaintext = cipher::empty_buffer<11, char>();
+        auto size = decoder.update(std::span{ plaintext }, std::span{ ciphertext.substr(0, 6) }).size;
+        size += decoder.update(std::span{ plaintext }.subspan(size), std::span{ ciphertext.substr(6) }).size;
+        decoder.finish(std::span{ plaintext }.subspan(size));
+        return plaintext;
+    }
+
+    constexpr static auto test_base64_8 = decode_b64_stream("SGVs\nbG8g\r\nV29y bGQ=\n");
+    static_assert(cipher::to_string(test_base64_8) == "Hello World"sv, cipher::to_string(test_base64_8));
+
+    constexpr static auto decode_b64_steps(const std::string_view ciphertext)
+    {
+        auto plaintext = cipher::empty_buffer<3, char>();
+        for(auto phase = 0u; phase < 4; phase++) {
+            const auto step = cipher::base64::decode_char(phase, ciphertext[phase]);
+            if (phase != 0)
+                plaintext[phase - 1] = static_cast<char>(plaintext[phase - 1] + step.finish);
+            if (phase != 3)
+                plaintext[phase] = static_cast<char>(step.start);
+        }
+        return plaintext;
+    }
+
+    constexpr static auto test_base64_9 = decode_b64_steps("SGVs");
+    static_assert(cipher::to_string(test_base64_9) == "Hel"sv, cipher::to_string(test_base64_9));
+
+}
+
+namespace period
+{
+    constexpr static auto plaintext = "It was the best of times, it was the worst of times, it was the age of wisdom, it was the age of foolishness, "
+                                      "it was the epoch of belief, it was the epoch of incredulity, it was the season of Light, it was the season "
+                                      "of Darkness, it was the spring of hope, it was the winter of despair, we had everything before us, we had "
+                                      "nothing before us, we were all going direct to Heaven, we were all going direct the other way."sv;
+    constexpr static auto key = "TheGi"sv;
+
+    constexpr static auto encrypt_base64()
+    {
+        auto base64 = cipher::empty_buffer<cipher::base64::encoded_size(plaintext.size(), false), char>();
+        cipher::base64::encode<false>(std::span{ base64 }, std::span{ plaintext });
+        auto ciphertext = base64;
+        cipher::vigenere::encode<false>(std::span{ ciphertext },
+                                        std::span{ base64 },
+                                        std::span{ key },
+                                        cipher::base64::DEFAULT_ALPHABET,
+                                        cipher::base64::DEFAULT_ASCII_TO_VALUE_ARRAY);
+        return ciphertext;
+    }
+
+    constexpr static auto ciphertext = encrypt_base64();
+
+    static_assert(cipher::period::rank(ciphertext, cipher::base64::DEFAULT_ASCII_TO_VALUE_ARRAY, 64, 8, 4).front().period == key.size());
+    // Every column holds a single character.
+    static_assert(cipher::period::rank("lnz"sv, cipher::base64::DEFAULT_ASCII_TO_VALUE_ARRAY, 64, 8, 4).empty());
+}
+
+namespace frequency
+{
+    // A value scores 0 where some pair of printable bytes makes it, -1 elsewhere.
+    constexpr static auto printable_model()
+    {
+        cipher::frequency::base64_model model;
+        for(auto& phase : model.log_probabilities)
+            phase.fill(-1.f);
+        for(auto a = 0u; a < 256; a++) {
+            if (!cipher::is_print(static_cast<char>(a)))
+                continue;
+            model.log_probabilities[0][a >> 2] = 0.f;
+            model.log_probabilities[3][a & 0x3f] = 0.f;
+            for(auto b = 0u; b < 256; b++) {
+                if (!cipher::is_print(static_cast<char>(b)))
+                    continue;
+                model.log_probabilities[1][(a & 0x03) << 4 | b >> 4] = 0.f;
+                model.log_probabilities[2][(a & 0x0f) << 2 | b >> 6] = 0.f;
+            }
+        }
+        return model;
+    }
+
+    constexpr static auto model = printable_model();
+
+    constexpr static auto decode = [](const std::string_view key, const std::size_t index) {
+        const auto value = [](const char c) { return cipher::base64::DEFAULT_ASCII_TO_VALUE_ARRAY[static_cast<std::uint8_t>(c)]; };
+        return cipher::base64::DEFAULT_ALPHABET[static_cast<std::size_t>(value(period::ciphertext[index]) - value(key[index % key.size()])) & 0x3f];
+    };
+
+    constexpr static auto columns()
+    {
+        std::vector<std::vector<cipher::frequency::candidate>> columns;
+        for(auto column = 0u; column < period::key.size(); column++)
+            columns.push_back(cipher::frequency::score_column<decode>(model, cipher::base64::DEFAULT_ALPHABET,
+                                                                      period::ciphertext.size(), period::key.size(), column));
+        return columns;
+    }
+
+    // The key built from the best character of every column.
+    constexpr static auto fit_key()
+    {
+        std::string key;
+        for(const auto& column : columns())
+            key.push_back(column.front().key_char);
+        return key;
+    }
+
+    static_assert(fit_key() == period::key);
+
+    // The first keys, which must start with the best one and come up once each,
+    // scoring no better than the one before.
+    constexpr static auto enumerate_keys(const std::size_t limit)
+    {
+        std::vector<std::string> keys;
+        std::vector<float> scores;
+        cipher::frequency::best_keys(columns(), limit, [&](const std::string_view key, const float score) {
+            keys.emplace_back(key);
+            scores.push_back(score);
+            return true;
+        });
+        if (keys.size() != limit || keys.front() != period::key)
+            return false;
+        for(auto i = 1u; i < keys.size(); i++) {
+            if (scores[i] > scores[i - 1])
+                return false;
+            if (std::find(keys.begin(), keys.begin() + i, keys[i]) != keys.begin() + i)
+                return false;
+        }
+        return true;
+    }
+
+    static_assert(enumerate_keys(16));
+}
+
+namespace bruteforce
+{
+    constexpr static auto ciphertext = "SGVsbG8gV29ybGQh"sv;
+
+    // The identity substitution: each known character fills its own slot.
+    constexpr static auto translate = [](auto& state, const std::size_t, const char c) {
+        const auto index = cipher::index_in_alphabet<cipher::base64::DEFAULT_ALPHABET>(c);
+        if (state.is_free(index))
+            state.alloc(index, c);
+    };
+
+    template<std::size_t phase>
+    constexpr static void decode_char(cipher::bruteforce::base64_alphabet_bruteforce_state<16>& state)
+    {
+        cipher::bruteforce::write_base64_char<phase>(state, ciphertext[state.ciphertext_index]);
+        cipher::bruteforce::enter_next_char<phase>(state);
+    }
+
+    // Starts from the crib and decodes the rest of the ciphertext with the steps
+    // the search takes, from wherever in a quantum the crib ends.
+    constexpr static auto decode_from_crib(const std::string_view crib)
+    {
+        auto state = cipher::bruteforce::create_state_with_plaintext<cipher::bruteforce::base64_alphabet_bruteforce_state<16>, translate>(crib);
+        while(state.ciphertext_index < ciphertext.size()) {
+            switch(state.ciphertext_index % 4) {
+                case 0: decode_char<0>(state); break;
+                case 1: decode_char<1>(state); break;
+                case 2: decode_char<2>(state); break;
+                default: decode_char<3>(state); break;
+            }
+        }
+        return state;
+    }
+
+    constexpr static auto test_crib_1 = decode_from_crib("Hello");
+    static_assert(test_crib_1.plaintext_string_view() == "Hello World!"sv);
+    static_assert(std::string_view{ test_crib_1.base64_plaintext, ciphertext.size() } == ciphertext);
+
+    constexpr static auto test_crib_2 = decode_from_crib("Hell");
+    static_assert(test_crib_2.plaintext_string_view() == "Hello World!"sv);
+    static_assert(std::string_view{ test_crib_2.base64_plaintext, ciphertext.size() } == ciphertext);
+
+    constexpr static auto test_crib_3 = decode_from_crib("Hello ");
+    static_assert(test_crib_3.plaintext_string_view() == "Hello World!"sv);
 }
 
 }
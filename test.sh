@@ -1,2 +1,3 @@
 #!/bin/bash
 clang++ -O3 test.cpp -march=native -std=c++26 -I. -Wall -Werror -Wconversion -fconstexpr-steps=1000000000 -fsyntax-only && echo "Pass!"
+clang++ -O1 test_simd.cpp -std=c++26 -I. -Wall -Werror -Wconversion -fsanitize=address,undefined -o test_simd && ./test_simd && echo "Pass!"
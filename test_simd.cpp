@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cstdint>
+#include <print>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include <cipher/alphabet.hpp>
+#include <cipher/base64.hpp>
+#include <cipher/simd.hpp>
+
+// test.cpp runs in constant evaluation, which never reaches the vector
+// kernels. This runs each kernel the CPU supports next to the scalar code on
+// random input: every size up to several registers, so all tail lengths come
+// up, and bytes from the whole range, non-ASCII ones included. Bytes past what
+// a kernel may write are checked to be left alone.
+
+namespace test
+{
+
+static std::minstd_rand random{ 0x5eed };
+static int failures{ 0 };
+
+// Past the end of every target, to catch stores that run over.
+constexpr static const std::size_t GUARD = 64;
+constexpr static const std::uint8_t GUARD_BYTE = 0xa5;
+constexpr static const std::size_t MAX_SIZE = 300;
+
+static void check(const bool ok, const std::string_view kernel, const std::size_t size, const std::string_view what)
+{
+    if (ok)
+        return;
+    std::println(stderr, "{}: size {}: {}", kernel, size, what);
+    failures++;
+}
+
+template<typename T>
+static bool guard_intact(const std::vector<T>& target, const std::size_t end)
+{
+    return std::all_of(target.begin() + static_cast<std::ptrdiff_t>(end), target.end(), [](const T c) {
+        return static_cast<std::uint8_t>(c) == GUARD_BYTE;
+    });
+}
+
+static std::uint8_t random_byte()
+{
+    return static_cast<std::uint8_t>(random() & 0xff);
+}
+
+// count distinct bytes below limit, in random order.
+static std::vector<char> random_alphabet(const std::size_t count, const unsigned limit)
+{
+    std::vector<char> bytes(limit);
+    for(auto i = 0u; i < limit; i++)
+        bytes[i] = static_cast<char>(i);
+    std::shuffle(bytes.begin(), bytes.end(), random);
+    bytes.resize(count);
+    return bytes;
+}
+
+// Mostly alphabet characters, the rest any byte.
+static std::vector<char> random_text(const std::size_t size, const std::span<const char> alphabet, const unsigned other_per_mille)
+{
+    std::vector<char> text(size);
+    for(auto& c : text)
+        c = random() % 1000 < other_per_mille ? static_cast<char>(random_byte()) : alphabet[random() % alphabet.size()];
+    return text;
+}
+
+#if CIPHER_SIMD_X86
+
+using cipher::simd::instruction_set;
+
+static bool supports(const instruction_set set)
+{
+    return cipher::simd::detect() >= set;
+}
+
+template<bool encode, auto kernel>
+static void vigenere(const std::string_view name, const std::size_t lanes)
+{
+    for(auto round = 0u; round < 8; round++) {
+        const auto alphabet = random_alphabet(2 + random() % 63, 128);
+        const auto tables = cipher::simd::vigenere_tables::create(std::span{ alphabet });
+        std::vector<char> key_chars(1 + random() % 40);
+        for(auto& c : key_chars)
+            c = alphabet[random() % alphabet.size()];
+        const auto key = cipher::simd::key_schedule::create(tables, std::span{ key_chars });
+
+        for(auto size = 0u; size <= MAX_SIZE; size++) {
+            const auto source = random_text(size, alphabet, 200);
+            std::vector<char> expected(size);
+            cipher::simd::vigenere_scalar<encode>(expected.data(), source.data(), 0, size, tables, key);
+
+            std::vector<char> target(size + GUARD, static_cast<char>(GUARD_BYTE));
+            const auto done = kernel(target.data(), source.data(), size, tables, key);
+            check(done == size / lanes * lanes, name, size, "stopped early");
+            check(guard_intact(target, size), name, size, "wrote past the end");
+            cipher::simd::vigenere_scalar<encode>(target.data(), source.data(), done, size, tables, key);
+            check(std::equal(expected.begin(), expected.end(), target.begin()), name, size, "differs from vigenere_scalar");
+        }
+    }
+}
+
+static void encode_reference(char* target, const std::uint8_t* source, const std::size_t quanta, const cipher::alphabet::alphabet_t<64>& alphabet)
+{
+    for(auto i = 0u; i < quanta; i++) {
+        const auto group = static_cast<std::uint32_t>(source[i * 3] << 16 | source[i * 3 + 1] << 8 | source[i * 3 + 2]);
+        for(auto j = 0u; j < 4; j++)
+            target[i * 4 + j] = alphabet[group >> (18 - 6 * j) & 0x3f];
+    }
+}
+
+template<auto kernel>
+static void encode(const std::string_view name, const std::size_t read)
+{
+    for(auto round = 0u; round < 4; round++) {
+        // Any byte alphabet works for encoding.
+        auto alphabet = cipher::base64::DEFAULT_ALPHABET;
+        if (round != 0)
+            std::ranges::copy(random_alphabet(64, 256), alphabet.begin());
+
+        for(auto size = 0u; size <= MAX_SIZE; size++) {
+            std::vector<std::uint8_t> source(size);
+            for(auto& byte : source)
+                byte = random_byte();
+
+            std::vector<char> target(size / 3 * 4 + GUARD, static_cast<char>(GUARD_BYTE));
+            const auto done = kernel(target.data(), source.data(), size, alphabet);
+            check(done % 3 == 0 && done + read > size && done <= size, name, size, "read the wrong amount");
+            check(guard_intact(target, done / 3 * 4), name, size, "wrote past what it encoded");
+            std::vector<char> expected(done / 3 * 4);
+            encode_reference(expected.data(), source.data(), done / 3, alphabet);
+            check(std::equal(expected.begin(), expected.end(), target.begin()), name, size, "differs from the scalar encode");
+        }
+    }
+}
+
+static void decode_reference(std::uint8_t* target, const char* source, const std::size_t quanta, const cipher::alphabet::ascii_to_index_t& ascii_to_value)
+{
+    for(auto i = 0u; i < quanta; i++) {
+        std::uint32_t group{ 0 };
+        for(auto j = 0u; j < 4; j++)
+            group = group << 6 | (ascii_to_value[static_cast<std::uint8_t>(source[i * 4 + j])] & 0x3fu);
+        for(auto j = 0u; j < 3; j++)
+            target[i * 3 + j] = static_cast<std::uint8_t>(group >> (16 - 8 * j));
+    }
+}
+
+template<auto kernel, auto checked_kernel>
+static void decode(const std::string_view name, const std::size_t lanes)
+{
+    for(auto round = 0u; round < 4; round++) {
+        // The decode kernels take ASCII alphabets only.
+        auto alphabet = cipher::base64::DEFAULT_ALPHABET;
+        if (round != 0)
+            std::ranges::copy(random_alphabet(64, 128), alphabet.begin());
+        const auto ascii_to_value = cipher::alphabet::create_ascii_to_index_array(alphabet);
+        const auto checked_ascii_to_value = cipher::base64::create_checked_ascii_to_value_array(alphabet);
+
+        for(auto size = 0u; size <= MAX_SIZE; size += 4) {
+            // Characters outside the alphabet decode like its first one.
+            const auto source = random_text(size, alphabet, 100);
+            std::vector<std::uint8_t> expected(size / 4 * 3);
+            decode_reference(expected.data(), source.data(), size / 4, ascii_to_value);
+
+            std::vector<std::uint8_t> target(size / 4 * 3 + GUARD, GUARD_BYTE);
+            const auto done = kernel(target.data(), source.data(), size, ascii_to_value);
+            check(done == size / lanes * lanes, name, size, "stopped early");
+            check(guard_intact(target, done / 4 * 3), name, size, "wrote past what it decoded");
+            check(std::equal(expected.begin(), expected.begin() + static_cast<std::ptrdiff_t>(done / 4 * 3), target.begin()),
+                  name, size, "differs from the scalar decode");
+
+            // Rare characters outside the alphabet, so that some registers
+            // get through before the first one.
+            const auto checked_source = random_text(size, alphabet, 3);
+            const auto invalid = [&](const std::size_t begin, const std::size_t end) {
+                return std::any_of(checked_source.begin() + static_cast<std::ptrdiff_t>(begin), checked_source.begin() + static_cast<std::ptrdiff_t>(end),
+                                   [&](const char c) { return checked_ascii_to_value[static_cast<std::uint8_t>(c)] == cipher::base64::INVALID; });
+            };
+            std::fill(target.begin(), target.end(), GUARD_BYTE);
+            const auto checked_done = checked_kernel(target.data(), checked_source.data(), size, checked_ascii_to_value);
+            check(checked_done % lanes == 0 && !invalid(0, checked_done), name, size, "checked decode went past an invalid character");
+            check(checked_done + lanes > size || invalid(checked_done, checked_done + lanes), name, size, "checked decode stopped at a valid register");
+            check(guard_intact(target, checked_done / 4 * 3), name, size, "checked decode wrote past what it decoded");
+            decode_reference(expected.data(), checked_source.data(), checked_done / 4, checked_ascii_to_value);
+            check(std::equal(expected.begin(), expected.begin() + static_cast<std::ptrdiff_t>(checked_done / 4 * 3), target.begin()),
+                  name, size, "checked decode differs from the scalar decode");
+        }
+    }
+}
+
+template<auto kernel>
+static void strip_whitespace(const std::string_view name, const std::size_t lanes)
+{
+    constexpr static const std::string_view whitespace = " \t\n\v\f\r";
+    for(auto round = 0u; round < 8; round++) {
+        // From no whitespace at all to mostly whitespace.
+        const auto whitespace_per_mille = round * 125;
+        for(auto size = 0u; size <= MAX_SIZE; size++) {
+            auto source = random_text(size, cipher::base64::DEFAULT_ALPHABET, 100);
+            for(auto& c : source)
+                if (random() % 1000 < whitespace_per_mille)
+                    c = whitespace[random() % whitespace.size()];
+
+            std::vector<char> target(size + GUARD, static_cast<char>(GUARD_BYTE));
+            const auto [read, written] = kernel(target.data(), source.data(), size);
+            std::vector<char> expected;
+            std::copy_if(source.begin(), source.begin() + static_cast<std::ptrdiff_t>(read), std::back_inserter(expected),
+                         [](const char c) { return !cipher::base64::is_whitespace(c); });
+            check(read % lanes == 0 && read + 2 * lanes > size && read <= size, name, size, "read the wrong amount");
+            check(guard_intact(target, size), name, size, "wrote past the end");
+            check(written == expected.size() && std::equal(expected.begin(), expected.end(), target.begin()),
+                  name, size, "differs from the scalar strip");
+        }
+    }
+}
+
+#endif
+
+}
+
+int main()
+{
+#if CIPHER_SIMD_X86
+    using namespace test;
+    using cipher::simd::instruction_set;
+
+    if (supports(instruction_set::ssse3)) {
+        encode<cipher::base64::encode_ssse3>("encode_ssse3", 16);
+        decode<cipher::base64::decode_ssse3<false>, cipher::base64::decode_ssse3<true>>("decode_ssse3", 16);
+        strip_whitespace<cipher::base64::strip_whitespace_ssse3>("strip_whitespace_ssse3", 16);
+    }
+    if (supports(instruction_set::sse41)) {
+        vigenere<true, cipher::simd::vigenere_sse41<true>>("vigenere_sse41 encode", 16);
+        vigenere<false, cipher::simd::vigenere_sse41<false>>("vigenere_sse41 decode", 16);
+    }
+    if (supports(instruction_set::avx2)) {
+        encode<cipher::base64::encode_avx2>("encode_avx2", 28);
+        decode<cipher::base64::decode_avx2<false>, cipher::base64::decode_avx2<true>>("decode_avx2", 32);
+        strip_whitespace<cipher::base64::strip_whitespace_avx2>("strip_whitespace_avx2", 32);
+        vigenere<true, cipher::simd::vigenere_avx2<true>>("vigenere_avx2 encode", 32);
+        vigenere<false, cipher::simd::vigenere_avx2<false>>("vigenere_avx2 decode", 32);
+    }
+    if (cipher::simd::detect() == instruction_set::scalar)
+        std::println("no vector kernels to test");
+    else if (failures == 0)
+        std::println("kernels match the scalar code");
+#else
+    std::println("built without vector kernels");
+#endif
+    return test::failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <print>
+#include <string_view>
+
+#include <argparse.hpp>
+
+#include <cipher/alphabet.hpp>
+#include <cipher/base64.hpp>
+
+int main(int argc, const char* argv[])
+{
+    argparse::ArgumentParser parser("base64");
+
+    parser.add_argument("-a", "--alphabet")
+        .default_value(std::string(cipher::base64::DEFAULT_ALPHABET.begin(), cipher::base64::DEFAULT_ALPHABET.size()));
+    parser.add_argument("-d", "--decode").flag().default_value(false);
+    parser.add_argument("--no-padding").flag().default_value(false);
+    parser.add_argument("source").required();
+
+    try {
+        parser.parse_args(argc, argv);
+    } catch(const std::exception& e) {
+        std::println(stderr, "{}", e.what());
+        std::cerr << parser;
+        std::exit(1);
+    }
+
+    const auto alphabet = parser.get<std::string>("--alphabet");
+    if (alphabet.size() != cipher::base64::DEFAULT_ALPHABET.size()) {
+        std::println(stderr, "--alphabet needs {} characters", cipher::base64::DEFAULT_ALPHABET.size());
+        std::exit(1);
+    }
+    cipher::alphabet::alphabet_t<cipher::base64::DEFAULT_ALPHABET.size()> alphabet_array;
+    std::copy(alphabet.begin(), alphabet.end(), alphabet_array.begin());
+
+    // Input goes through in chunks, so stdin of any size runs in constant
+    // memory.
+    const auto source = parser.get<std::string>("source");
+    constexpr static std::size_t CHUNK_SIZE = 1 << 16;
+    std::array<char, CHUNK_SIZE> chunk;
+    const auto read = [&](const auto& process) {
+        if (source != "-") {
+            for(auto i = 0u; i < source.size(); i += CHUNK_SIZE)
+                process(std::span{ source }.subspan(i, std::min(CHUNK_SIZE, source.size() - i)));
+            return;
+        }
+        while (std::cin.read(chunk.data(), chunk.size()) || std::cin.gcount() != 0)
+            process(std::span{ chunk }.first(static_cast<std::size_t>(std::cin.gcount())));
+    };
+
+    if (parser.get<bool>("--decode")) {
+        cipher::base64::decoder decoder{ alphabet_array };
+        std::array<char, (CHUNK_SIZE + 3) / 4 * 3> plaintext;
+        const auto write = [&](const cipher::base64::decode_result& result) {
+            std::cout.write(plaintext.data(), static_cast<std::streamsize>(result.size));
+            if (result.invalid) {
+                std::cout.flush();
+                std::println(stderr, "INVALID BASE64 AT OFFSET {}", *result.invalid);
+                std::exit(1);
+            }
+        };
+        read([&](const auto text) {
+            write(decoder.update(std::span{ plaintext }, text));
+        });
+        write(decoder.finish(std::span{ plaintext }));
+        return 0;
+    }
+
+    cipher::base64::encoder encoder{ alphabet_array, !parser.get<bool>("--no-padding") };
+    std::array<char, cipher::base64::encoded_size(CHUNK_SIZE + 2)> ciphertext;
+    read([&](const auto text) {
+        const auto size = encoder.update(std::span{ ciphertext }, text);
+        std::cout.write(ciphertext.data(), static_cast<std::streamsize>(size));
+    });
+    const auto size = encoder.finish(std::span{ ciphertext });
+    std::cout.write(ciphertext.data(), static_cast<std::streamsize>(size));
+    std::cout << '\n';
+}
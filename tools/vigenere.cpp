@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
 #include <iostream>
 #include <print>
 #include <string_view>
@@ -33,6 +36,29 @@ int main(int argc, const char* argv[])
     if (debug)
         std::println(stderr, "SOURCE: _{}_", source);
 
+    // Autokey decoding of stdin streams in chunks, so input of any size runs in
+    // constant memory.
+    const auto alphabet_size = parser.get<std::string>("--alphabet").size();
+    if (source == "-" && parser.get<bool>("--decode") && parser.get<bool>("--autokey") && alphabet_size == cipher::base64::DEFAULT_ALPHABET.size()) {
+        const auto alphabet = parser.get<std::string>("--alphabet");
+        const auto key = parser.get<std::string>("--key");
+        cipher::alphabet::alphabet_t<cipher::base64::DEFAULT_ALPHABET.size()> alphabet_array;
+        std::copy(alphabet.begin(), alphabet.end(), alphabet_array.begin());
+        cipher::vigenere::autokey_decoder<cipher::base64::DEFAULT_ALPHABET.size()> decoder{ alphabet_array, std::span{ key } };
+
+        std::array<char, 1 << 16> chunk;
+        std::array<char, 1 << 16> plaintext;
+        while (std::cin.read(chunk.data(), chunk.size()) || std::cin.gcount() != 0) {
+            const auto end = std::remove_if(chunk.begin(), chunk.begin() + std::cin.gcount(),
+                                            [](const char c) { return std::isspace(static_cast<unsigned char>(c)); });
+            const auto size = static_cast<std::size_t>(end - chunk.begin());
+            decoder.decode(std::span{ plaintext }.first(size), std::span{ chunk }.first(size));
+            std::cout.write(plaintext.data(), static_cast<std::streamsize>(size));
+        }
+        std::cout << '\n';
+        return 0;
+    }
+
     if (source == "-") {
         source.clear();
         std::string temp;